@@ -16,9 +16,27 @@
 #include <ArduinoJson.h>
 #include <Preferences.h>
 #include <time.h>
+#include <HTTPClient.h>
+#include <Update.h>
+#include <esp_ota_ops.h>
+#include <mbedtls/sha256.h>
+#include <esp_sntp.h>
+#include <esp_timer.h>
+#include <esp_sleep.h>
+#include <driver/rtc_io.h>
 
 #include "index.h"  // Web Dashboard (Glassmorphism & Piano)
 #include "songs.h"  // 37 Melodies + Bells
+#include "sensor_health.h"  // Rail/stuck/floating/NaN detectors per channel
+#include "occupancy.h"  // Presence estimator (host-tested, see tests/)
+#include "ventilation.h"  // CO2/temperature forecast and fan levels
+#include "reply_writer.h"  // Fixed-buffer streaming replies
+#include "history.h"  // Week of 5-minute means for /api/v2/history
+#include "play_queue.h"  // Buzzer priorities: alarm > bell > music
+#include "compliance.h"  // Range/exceedance counters and percentile histograms
+#include "ota.h"  // Streaming, hash-verified flasher
+#include "timesync.h"  // NTP + drift-corrected monotonic clock
+#include "power.h"  // Sleep/clock decisions and sound-wake back-off
 
 // ================= PIN CONFIGURATION =================
 #define PIN_DHT         18
@@ -28,7 +46,7 @@
 #define PIN_LDR         34
 #define PIN_MQ135       35  // Air Quality
 #define PIN_MQ2         33  // Smoke / Cigarette (NEW)
-#define PIN_SOUND       32
+#define PIN_SOUND       32  // Must be an RTC GPIO: ext0 wake from light sleep
 #define PIN_TRIG        5
 #define PIN_ECHO        19
 
@@ -36,6 +54,8 @@
 #define PWM_CHANNEL     0
 #define PWM_RESOLUTION  8
 #define PWM_FREQ        2000
+#define FAN_CHANNEL     2     // Own LEDC timer, buzzer retunes timer 0
+#define FAN_FREQ        25000
 #define DHTTYPE         DHT22
 
 // ================= HEALTH STANDARDS (KEMENKES/WHO) =================
@@ -47,6 +67,54 @@ const float HUMID_MAX_STD = 60.0;
 const float NOISE_MAX_STD = 55.0; // dB for Schools
 const int   CO2_MAX_STD   = 1000; // PPM (Good Ventilation)
 
+// ================= SENSOR HEALTH =================
+enum { CH_TEMP = 0, CH_HUMID, CH_MQ135, CH_MQ2, CH_SOUND, CH_LDR, SENSOR_CHANNELS };
+const ChannelSpec SENSOR_SPEC[SENSOR_CHANNELS] = {
+  {"t",     -40.0, 80.0,   3600, 0,   -1},  // DHT22 limits, 2 h unchanged
+  {"h",       0.0, 100.0,  3600, 0,   -1},
+  {"gas",     0.0, 4095.0, 300,  400, -1},  // Raw ADC; gas drifts slowly, a floating pin jumps
+  {"mq2",     0.0, 4095.0, 300,  400, -1},
+  {"db",     -1.0, 4095.0, 0,    1100, 0},  // A silent night reads 0 for hours; lessons peak
+                                            // at an SD of ~760/tick, a floating pin ~1700
+  {"lux",    -1.0, 4096.0, 0,    500, -1}   // Dark/bright room may sit on either rail
+};
+
+// ================= VENTILATION FORECAST =================
+const float FAN_TEMP_ON      = 28.0;        // Comfort threshold (below TEMP_MAX_STD)
+const VentLimits VENT_LIMITS = {CO2_MAX_STD, FAN_TEMP_ON, TEMP_MAX_STD};
+const uint8_t FAN_DUTY[FAN_LEVELS] = {0, 110, 180, 255};
+
+// ================= COMPLIANCE STATISTICS =================
+#define STAT_METRICS    4
+enum { STAT_TEMP = 0, STAT_HUMID, STAT_NOISE, STAT_CO2 };
+const MetricSpec STAT_SPEC[STAT_METRICS] = {
+  {"Suhu",   "C",   (int32_t)(TEMP_MIN_STD * 10),  (int32_t)(TEMP_MAX_STD * 10),  10},  // 0-64 C
+  {"Lembab", "%",   (int32_t)(HUMID_MIN_STD * 10), (int32_t)(HUMID_MAX_STD * 10), 20},  // 0-128 %
+  {"Suara",  "dB",  0,                             (int32_t)(NOISE_MAX_STD * 10), 20},  // 0-128 dB
+  {"Udara",  "PPM", 0,                             CO2_MAX_STD * 10,              640}  // 0-4096
+};
+
+// ================= STREAM WRITER =================
+#define TG_HOST         "api.telegram.org"
+const unsigned long TG_REPLY_TIMEOUT = 3000;
+
+// ================= PLAYBACK QUEUE =================
+#define SONG_COUNT      (int)(sizeof(SONGS) / sizeof(SONGS[0]))
+const int SONG_BELL_ENTRY     = 25; // SONGS index ("26. Entry")
+const int SONG_BELL_BREAK     = 26;
+const int SONG_BELL_END       = 27;
+const int SONG_SIREN_SMOKE    = 34; // Ambulance
+const int SONG_SIREN_INTRUDER = 35; // Police
+
+// ================= POWER MANAGER =================
+const unsigned long DHT_INTERVAL_MS    = 2000;
+const unsigned long ANALOG_INTERVAL_MS = 1000;
+const unsigned long BOT_INTERVAL_MS    = 3000;
+
+// ================= OTA UPDATE =================
+const unsigned long OTA_HEALTH_MIN_MS  = 60000;  // New image must run this long...
+const unsigned long OTA_HEALTH_MAX_MS  = 300000; // ...and be healthy before this, or roll back
+
 const long GMT_OFFSET_SEC   = 25200; // UTC+7
 const int DAYLIGHT_OFFSET   = 0;
 
@@ -77,34 +145,113 @@ bool auto_bell = true;  // School Bell Schedule
 String mood = "Netral";
 String ai_status = "Initializing...";
 String health_status = "Checking...";
-String time_str = "--:--";
+char time_str[6] = "--:--";
 int current_hour = 0;
 int current_minute = 0;
-bool is_day_time = true;
+int current_yday = -1;  // Day of year, -1 until NTP sync
+bool is_day_time = true; // Stays true until synced: no false intruder alarms
 bool alert_active = false;
 bool presence_detected = false;
 bool smoke_detected = false;
 
+// Sensor Health (constant memory per channel, see sensor_health.h)
+ChannelHealth sensor_health[SENSOR_CHANNELS];
+
+// History Store (see history.h)
+HistStore hist;
+
+// Occupancy (sliding windows, O(1) per tick, see occupancy.h)
+Occupancy occ;
+
+// Ventilation (sliding least-squares, O(1) per sample, see ventilation.h)
+Ventilation vent;
+int fan_level = 0;
+
+// Compliance (reset at midnight, see compliance.h)
+MetricStats stats[STAT_METRICS];
+uint32_t stats_class_s = 0; // Class-hour ticks, whatever the sensors did
+int stats_yday = -1;
+
 // Timers
 unsigned long last_dht = 0;
 unsigned long last_analog = 0;
+bool sense_now = false; // Sound wake: one extra analog tick, schedule unchanged
 unsigned long last_bot = 0;
 unsigned long last_wifi_check = 0;
 unsigned long scan_start_time = 0;
-unsigned long last_bell_check = 0;
-
-// Music Engine
-bool is_playing = false;
-int note_index = 0;
-unsigned long last_note_start = 0;
-bool note_state = false;
-int current_song_id = 0;
+unsigned long last_vent_sample = 0;
+
+// OTA (cooperative: one chunk per loop, sensing/bells keep running)
+class UpdateFlash : public OtaFlash {
+public:
+  bool begin(size_t size) { return Update.begin(size); }
+  size_t write(uint8_t* data, size_t len) { return Update.write(data, len); }
+  bool end() { return Update.end(); }
+  void abort() { Update.abort(); }
+  const char* errorString() { return Update.errorString(); }
+};
+UpdateFlash ota_flash;
+OtaJob ota;
+HTTPClient ota_http;
+String ota_key = "";             // POST /ota needs it in X-OTA-Key
+unsigned long ota_reboot_at = 0;
+bool ota_pending_verify = false; // Booted into a new image, not yet confirmed
+
+// Time Service (wall = monotonic + offset, drift-corrected between syncs)
+TimeService timesvc;
+time_t time_next_minute = 0; // Wall second of the next minute boundary
+portMUX_TYPE ntp_mux = portMUX_INITIALIZER_UNLOCKED; // SNTP task -> loop() handoff
+bool ntp_pending = false;
+int64_t ntp_wall_us = 0;
+int64_t ntp_mono_us = 0;
+
+// Power Manager (time per state, for /metrics)
+PowerMeter power;
+SoundWake sound_wake;
+unsigned long last_http = 0;
+
+// Stream Writer (replies never overlap, so one buffer serves all of them)
+char reply_buf[REPLY_BUF_SIZE];
+
+// Music Engine (queue and note timing in play_queue.h)
+class BuzzerOutput : public PlayOutput {
+public:
+  void tone(int freq) { ledcWriteTone(PWM_CHANNEL, freq); }
+  int songCount() { return SONG_COUNT; }
+  int songLength(int song) { return SONGS[song].length; }
+  int songNote(int song, int i, int &tempo) {
+    tempo = pgm_read_word(&(SONGS[song].tempo[i]));
+    return pgm_read_word(&(SONGS[song].melody[i]));
+  }
+};
+BuzzerOutput buzzer_out;
+Player player = { &buzzer_out };
 
 // ================= PROTOTYPES =================
 void handleSaveSettings();
 void readDHT();
 void readAnalogSensors();
 void logicAI();
+bool sensorCheck(int ch, float v);
+bool sensorValid(int ch);
+void updateOccupancy();
+void updateVentilation();
+void setFan(int level);
+void updateCompliance();
+void statAdd(int m, int32_t v10);
+void writeReport(ReplyWriter &out, const char* title, bool markdown);
+void httpSink(const char* data, size_t len);
+void httpStreamBegin(const char* type);
+bool tgOpen(ReplyWriter &w, const String &cid, const char* parse_mode);
+bool tgClose(ReplyWriter &w);
+void handleReport();
+void otaKeyInit();
+bool otaStart(const String &url, const String &sha_hex);
+void otaStep();
+void otaHealthCheck();
+void handleOta();
+void updateHistory();
+void handleHistory();
 void checkBellSchedule();
 void handleJson();
 void handleCommand();
@@ -114,16 +261,27 @@ void handleTelegram(int numNewMessages);
 void checkWiFi();
 int smoothAnalog(int pin);
 void updateTime();
+void onNtpSync(struct timeval* tv);
+int64_t timeNowUs();
+uint32_t timeErrorMs();
 void handleScanWiFi();
 void handleRoot();
+void powerManage();
+void powerEnter(PowerState st);
+unsigned long powerNextDeadline();
+void powerTouch();
+void handleMetrics();
 void playTone(int freq, int duration);
-void playSong(int id);
+bool playSong(int id, uint8_t prio);
+void playStopMusic();
 
 // ================= SETUP =================
 void setup() {
   Serial.begin(115200);
 
-  pinMode(PIN_FAN, OUTPUT);
+  ledcSetup(FAN_CHANNEL, FAN_FREQ, PWM_RESOLUTION);
+  ledcAttachPin(PIN_FAN, FAN_CHANNEL);
+  ledcWrite(FAN_CHANNEL, 0);
   pinMode(PIN_LAMP, OUTPUT);
   pinMode(PIN_TRIG, OUTPUT);
   pinMode(PIN_ECHO, INPUT);
@@ -138,6 +296,12 @@ void setup() {
 
   dht.begin();
 
+  // Image still on probation after an OTA? (see otaHealthCheck)
+  esp_ota_img_states_t ota_img;
+  if (esp_ota_get_state_partition(esp_ota_get_running_partition(), &ota_img) == ESP_OK) {
+    ota_pending_verify = (ota_img == ESP_OTA_IMG_PENDING_VERIFY);
+  }
+
   pref.begin("smartclass", false);
   ssid_name = pref.getString("ssid", ssid_name);
   ssid_pass = pref.getString("pass", ssid_pass);
@@ -157,26 +321,38 @@ void setup() {
   }
 
   if(WiFi.status() == WL_CONNECTED) {
+    WiFi.mode(WIFI_STA); // No AP once joined: modem sleep needs STA-only mode
     Serial.println("\nWiFi OK!");
     Serial.println(WiFi.localIP());
-    configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET, "pool.ntp.org", "time.nist.gov");
   } else {
     Serial.println("\nWiFi Fail. AP: SmartClass_AP");
     WiFi.softAP("SmartClass_AP");
     Serial.println(WiFi.softAPIP());
   }
 
+  // SNTP keeps retrying in the background, also after a late WiFi join
+  sntp_set_time_sync_notification_cb(onNtpSync);
+  configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET, "pool.ntp.org", "time.nist.gov");
+
+  otaKeyInit(); // After WiFi start: esp_random() is a true RNG once the radio runs
+
   client.setInsecure();
+  static const char* OTA_HEADERS[] = {"X-OTA-Key"};
+  server.collectHeaders(OTA_HEADERS, 1);
   server.on("/", handleRoot);
   server.on("/data", handleJson);
   server.on("/cmd", handleCommand);
   server.on("/csv", handleDownload);
   server.on("/scan", handleScanWiFi);
+  server.on("/report", handleReport);
+  server.on("/ota", handleOta);
+  server.on("/api/v2/history", handleHistory);
+  server.on("/metrics", handleMetrics);
   server.on("/save", HTTP_POST, handleSaveSettings);
   server.enableCORS(true);
   server.begin();
 
-  playSong(0); // Startup Sound (Mario)
+  playSong(0, PRIO_MUSIC); // Startup Sound (Mario)
 }
 
 // ================= LOOP =================
@@ -184,27 +360,34 @@ void loop() {
   server.handleClient();
   handleMusic();
   checkWiFi();
+  otaStep();
+  otaHealthCheck();
 
   unsigned long now = millis();
 
   // DHT Read (Every 2s)
-  if (now - last_dht > 2000) {
+  if (now - last_dht > DHT_INTERVAL_MS) {
     last_dht = now;
     readDHT();
   }
 
   // Analog & Logic (Every 1s)
-  if (now - last_analog > 1000) {
-    last_analog = now;
+  bool analog_due = now - last_analog > ANALOG_INTERVAL_MS;
+  if (analog_due || sense_now) {
+    if (analog_due) last_analog = now;
+    sense_now = false;
     readAnalogSensors();
-    updateTime();
-    checkBellSchedule();
+    updateTime(); // Rings bells on minute boundaries
+    updateOccupancy();
+    updateVentilation();
     logicAI();
+    updateCompliance();
+    updateHistory();
     Serial.print("AI:"); Serial.print(ai_status); Serial.print(" T:"); Serial.println(t);
   }
 
   // Telegram (Every 3s)
-  if (WiFi.status() == WL_CONNECTED && !is_playing && (now - last_bot > 3000)) {
+  if (WiFi.status() == WL_CONNECTED && !player.playing && (now - last_bot > BOT_INTERVAL_MS)) {
     last_bot = now;
     int numNewMessages = bot.getUpdates(bot.last_message_received + 1);
     while(numNewMessages) {
@@ -212,23 +395,98 @@ void loop() {
       numNewMessages = bot.getUpdates(bot.last_message_received + 1);
     }
   }
+
+  powerManage();
+}
+
+// ================= SENSOR HEALTH =================
+// Feeds one reading into the channel's detectors; returns false while faulty.
+// Raises a Telegram maintenance alert on each fault/recovery transition.
+bool sensorCheck(int ch, float v) {
+  ChannelHealth &hs = sensor_health[ch];
+  const ChannelSpec &sp = SENSOR_SPEC[ch];
+  if (sensorUpdate(hs, sp, v)) {
+    String msg = (hs.fault == FAULT_NONE) ? "✅ Sensor pulih: " : "🛠️ Perlu perawatan, sensor ";
+    msg += String(sp.name);
+    if (hs.fault != FAULT_NONE) msg += " (" + String(sensorFaultName(hs.fault)) + ")";
+    bot.sendMessage(chat_id, msg, "");
+  }
+  return hs.fault == FAULT_NONE;
+}
+
+bool sensorValid(int ch) {
+  return sensor_health[ch].fault == FAULT_NONE;
+}
+
+// ================= OCCUPANCY ESTIMATOR =================
+void updateOccupancy() {
+  presence_detected = occupancyUpdate(occ, dist, db, lux, sensorValid(CH_SOUND), sensorValid(CH_LDR));
+}
+
+// ================= VENTILATION FORECAST =================
+void updateVentilation() {
+  if (millis() - last_vent_sample < VENT_SAMPLE_MS) return;
+  last_vent_sample = millis();
+  ventilationSample(vent, gas_mq135, t, sensorValid(CH_MQ135), sensorValid(CH_TEMP));
+}
+
+void setFan(int level) {
+  fan_level = constrain(level, 0, FAN_LEVELS - 1);
+  st_fan = (fan_level > 0);
+  ledcWrite(FAN_CHANNEL, FAN_DUTY[fan_level]);
+}
+
+// ================= COMPLIANCE STATISTICS =================
+void statAdd(int m, int32_t v10) {
+  statAdd(stats[m], STAT_SPEC[m], v10);
+}
+
+// markdown: bold metric names for Telegram; /report is text/plain.
+void writeReport(ReplyWriter &out, const char* title, bool markdown) {
+  statReport(out, stats, STAT_SPEC, STAT_METRICS, stats_class_s, title, markdown);
+}
+
+void updateCompliance() {
+  // Midnight rollover: push yesterday's report, then start fresh
+  if (current_yday >= 0 && current_yday != stats_yday) {
+    if (stats_yday >= 0 && stats_class_s > 0) { // Even with the DHT22 down all day
+      ReplyWriter w(&client);
+      if (tgOpen(w, chat_id, "Markdown")) {
+        writeReport(w, "📋 *Laporan Harian Kepatuhan*", true);
+        tgClose(w);
+      }
+    }
+    memset(stats, 0, sizeof(stats));
+    stats_class_s = 0;
+    stats_yday = current_yday;
+  }
+
+  if (!is_day_time) return; // Class hours only
+  stats_class_s++;
+  if (sensorValid(CH_TEMP))  statAdd(STAT_TEMP,  (int32_t)lroundf(t * 10));
+  if (sensorValid(CH_HUMID)) statAdd(STAT_HUMID, (int32_t)lroundf(h * 10));
+  if (sensorValid(CH_SOUND)) statAdd(STAT_NOISE, (int32_t)lroundf(db * 10));
+  if (sensorValid(CH_MQ135)) statAdd(STAT_CO2,   (int32_t)gas_mq135 * 10);
 }
 
 // ================= LOGIC AI & HEALTH =================
 void logicAI() {
-  // 1. Presence Detection
-  presence_detected = ((dist > 0 && dist < 150) || (db > 60));
+  // 1. Presence Detection (see updateOccupancy)
 
   // 2. Health & Comfort Status (Based on Standards)
+  // Faulty channels are skipped (see sensorCheck)
+  bool t_ok = sensorValid(CH_TEMP), h_ok = sensorValid(CH_HUMID);
+  bool db_ok = sensorValid(CH_SOUND), co2_ok = sensorValid(CH_MQ135);
   String health = "OK ✅";
-  if (t < TEMP_MIN_STD || t > TEMP_MAX_STD) health = "Suhu Tidak Ideal ⚠️";
-  if (h < HUMID_MIN_STD || h > HUMID_MAX_STD) health = "Lembab Tidak Ideal ⚠️";
-  if (db > NOISE_MAX_STD) health = "Bising! 🔇";
-  if (gas_mq135 > CO2_MAX_STD) health = "Udara Kotor! 💨";
+  if (t_ok && (t < TEMP_MIN_STD || t > TEMP_MAX_STD)) health = "Suhu Tidak Ideal ⚠️";
+  if (h_ok && (h < HUMID_MIN_STD || h > HUMID_MAX_STD)) health = "Lembab Tidak Ideal ⚠️";
+  if (db_ok && db > NOISE_MAX_STD) health = "Bising! 🔇";
+  if (co2_ok && gas_mq135 > CO2_MAX_STD) health = "Udara Kotor! 💨";
   health_status = health;
 
   // 3. Smoke Detection (MQ2)
-  if (gas_mq2 > 2000) { // Threshold for smoke
+  if (sensorValid(CH_MQ2) && gas_mq2 > 2000) { // Threshold for smoke
+    if (!smoke_detected) playSong(SONG_SIREN_SMOKE, PRIO_ALARM);
     smoke_detected = true;
     ai_status = "ROKOK TERDETEKSI! 🚭";
     bot.sendMessage(chat_id, "🚭 PERINGATAN: Asap Rokok Terdeteksi di Kelas!", "");
@@ -238,7 +496,7 @@ void logicAI() {
 
   // 4. Mood Calculation
   int stress = 0;
-  if (t > 28) stress += 30; if (db > 60) stress += 30; if (gas_mq135 > 1500) stress += 30;
+  if (t_ok && t > 28) stress += 30; if (db_ok && db > 60) stress += 30; if (co2_ok && gas_mq135 > 1500) stress += 30;
   if (stress < 30) mood = "Nyaman 😊"; else if (stress < 60) mood = "Fokus 😐"; else mood = "Buruk 😡";
 
   if (!mode_ai) {
@@ -251,24 +509,25 @@ void logicAI() {
     if (is_day_time) {
       if (!smoke_detected) ai_status = "Class Active 🟢";
       // Comfort Control
-      if (t > 28.0) { st_fan = true; digitalWrite(PIN_FAN, HIGH); }
-      else { st_fan = false; digitalWrite(PIN_FAN, LOW); }
+      setFan(ventilationLevel(vent, VENT_LIMITS, gas_mq135, t, sensorValid(CH_MQ135), sensorValid(CH_TEMP), fan_level));
 
-      if (lux < 400) { st_lamp = true; digitalWrite(PIN_LAMP, HIGH); }
+      if (!sensorValid(CH_LDR) || lux < 400) { st_lamp = true; digitalWrite(PIN_LAMP, HIGH); }
       else { st_lamp = false; digitalWrite(PIN_LAMP, LOW); }
     } else {
       // Night Intruder
       ai_status = "INTRUDER ALERT! 🔴";
       st_lamp = true; digitalWrite(PIN_LAMP, HIGH);
-      st_fan = true; digitalWrite(PIN_FAN, HIGH);
+      setFan(FAN_LEVELS - 1);
       if (!alert_active) {
+        playSong(SONG_SIREN_INTRUDER, PRIO_ALARM);
         bot.sendMessage(chat_id, "⚠️ PERINGATAN! Gerakan malam hari!", "");
         alert_active = true;
       }
     }
   } else {
     if (!smoke_detected) ai_status = "Class Empty ⚪";
-    st_fan = false; digitalWrite(PIN_FAN, LOW);
+    // Empty room: only flush air that is already bad
+    setFan(co2_ok && gas_mq135 > CO2_MAX_STD ? 1 : 0);
     st_lamp = false; digitalWrite(PIN_LAMP, LOW);
     alert_active = false;
   }
@@ -276,86 +535,60 @@ void logicAI() {
 
 // ================= SCHOOL BELL SCHEDULE =================
 void checkBellSchedule() {
-  if (!auto_bell) return;
-  if (millis() - last_bell_check < 60000) return; // Check every minute
-  last_bell_check = millis();
+  // Called once per wall-clock minute by updateTime(); a resync can repeat one
+  static int last_bell_slot = -1;
+  int slot = current_hour * 60 + current_minute;
+  if (!auto_bell || slot == last_bell_slot) return;
+  last_bell_slot = slot;
 
   // Schedule (Mon-Fri assumed)
   if (current_hour == 7 && current_minute == 0) {
-    playSong(26); // Entry Bell
+    playSong(SONG_BELL_ENTRY, PRIO_BELL);
     bot.sendMessage(chat_id, "🔔 Bel Masuk (07:00)", "");
   }
   else if (current_hour == 10 && current_minute == 0) {
-    playSong(27); // Break Bell
+    playSong(SONG_BELL_BREAK, PRIO_BELL);
     bot.sendMessage(chat_id, "🔔 Bel Istirahat (10:00)", "");
   }
   else if (current_hour == 14 && current_minute == 0) {
-    playSong(28); // End Bell
+    playSong(SONG_BELL_END, PRIO_BELL);
     bot.sendMessage(chat_id, "🔔 Bel Pulang (14:00)", "");
   }
 }
 
 // ================= MUSIC ENGINE =================
-void playSong(int id) {
-  if (id < 0 || id >= 37) return; // Max Index 36 (Size 37)
-  current_song_id = id;
-  is_playing = true;
-  note_index = 0;
-  note_state = false;
-  last_note_start = millis();
+bool playSong(int id, uint8_t prio) {
+  return playSong(player, id, prio, millis());
 }
 
-void handleMusic() {
-  if (!is_playing) return;
-  unsigned long now = millis();
-
-  int note_freq = pgm_read_word(&(SONGS[current_song_id].melody[note_index]));
-  int note_tempo = pgm_read_word(&(SONGS[current_song_id].tempo[note_index]));
-
-  int duration = 1000 / note_tempo;
-  int pause = duration * 1.30;
+void playTone(int freq, int duration) {
+  playTone(player, freq, duration, millis());
+}
 
-  if (!note_state) {
-    if (note_freq > 0) ledcWriteTone(PWM_CHANNEL, note_freq);
-    else ledcWriteTone(PWM_CHANNEL, 0);
-    note_state = true;
-    last_note_start = now;
-  } else {
-    if (now - last_note_start > duration) ledcWriteTone(PWM_CHANNEL, 0);
-    if (now - last_note_start > pause) {
-      note_state = false;
-      note_index++;
-      int song_len = SONGS[current_song_id].length;
-      if (note_index >= song_len) {
-        note_index = 0;
-        is_playing = false; // Stop after one loop for bells/songs
-      }
-    }
-  }
+void playStopMusic() {
+  playStopMusic(player, millis());
 }
 
-void playTone(int freq, int duration) {
-  is_playing = false;
-  ledcWriteTone(PWM_CHANNEL, freq);
-  delay(duration);
-  ledcWriteTone(PWM_CHANNEL, 0);
+void handleMusic() {
+  playTick(player, millis());
 }
 
 // ================= HANDLERS =================
 
 void handleCommand() {
+  powerTouch();
   String act = server.arg("do");
 
-  if (act == "fan_toggle") { mode_ai = false; st_fan = !st_fan; digitalWrite(PIN_FAN, st_fan); }
+  if (act == "fan_toggle") { mode_ai = false; setFan(st_fan ? 0 : FAN_LEVELS - 1); }
   if (act == "lamp_toggle") { mode_ai = false; st_lamp = !st_lamp; digitalWrite(PIN_LAMP, st_lamp); }
   if (act == "ai_toggle") { mode_ai = !mode_ai; }
   if (act == "bell_toggle") { auto_bell = !auto_bell; }
 
   if (act == "music_play") {
-    if (server.hasArg("id")) playSong(server.arg("id").toInt());
+    if (server.hasArg("id")) playSong(server.arg("id").toInt(), PRIO_MUSIC);
   }
 
-  if (act == "music_stop") { is_playing = false; ledcWriteTone(PWM_CHANNEL, 0); }
+  if (act == "music_stop") { playStopMusic(); }
 
   if (act == "tone") {
     int f = server.arg("freq").toInt();
@@ -377,26 +610,34 @@ void handleTelegram(int n) {
     }
 
     if (txt == "/start") {
-      String msg = "🤖 *Smart Class Ultimate*\n";
-      msg += "Halo " + from_name + "!\n\n";
-      msg += "📱 *Menu Perintah:*\n";
-      msg += "/info - Info Sistem & IP\n";
-      msg += "/dashboard - Link Web Dashboard\n";
-      msg += "/status - Cek Sensor & Kesehatan\n";
-      msg += "/download - Link Download Data\n";
-      msg += "/musik - Daftar Lagu\n";
-      msg += "/ai [on/off] - Mode Otomatis\n";
-      msg += "/stop - Matikan Suara\n\n";
-      msg += "Admin ID: " + chat_id;
-      bot.sendMessage(cid, msg, "Markdown");
+      ReplyWriter w(&client);
+      if (tgOpen(w, cid, "Markdown")) {
+        w.print(F("🤖 *Smart Class Ultimate*\n"));
+        w.print(F("Halo ")); w.print(from_name); w.print(F("!\n\n"));
+        w.print(F("📱 *Menu Perintah:*\n"
+                  "/info - Info Sistem & IP\n"
+                  "/dashboard - Link Web Dashboard\n"
+                  "/status - Cek Sensor & Kesehatan\n"
+                  "/download - Link Download Data\n"
+                  "/report - Laporan Kepatuhan Hari Ini\n"
+                  "/musik - Daftar Lagu\n"
+                  "/ai [on/off] - Mode Otomatis\n"
+                  "/stop - Matikan Suara\n\n"));
+        w.print(F("Admin ID: ")); w.print(chat_id);
+        tgClose(w);
+      }
     }
     else if (txt == "/info") {
-      String msg = "ℹ️ *System Info*\n";
-      msg += "📶 WiFi: " + String(WiFi.SSID()) + " (" + String(WiFi.RSSI()) + "dBm)\n";
-      msg += "🌐 IP: " + WiFi.localIP().toString() + "\n";
-      msg += "⏱️ Waktu: " + time_str + "\n";
-      msg += "🤖 AI Mode: " + String(mode_ai ? "ON" : "OFF");
-      bot.sendMessage(cid, msg, "Markdown");
+      ReplyWriter w(&client);
+      if (tgOpen(w, cid, "Markdown")) {
+        w.print(F("ℹ️ *System Info*\n"));
+        w.printf_P(PSTR("📶 WiFi: %s (%lddBm)\n"), WiFi.SSID().c_str(), (long)WiFi.RSSI());
+        w.printf_P(PSTR("🌐 IP: %s\n"), WiFi.localIP().toString().c_str());
+        w.printf_P(PSTR("⏱️ Waktu: %s (%s, drift %.1f ppm)\n"), time_str,
+                   timesvc.sync == TIME_SYNCED ? "NTP" : (timesvc.sync == TIME_HOLDOVER ? "holdover" : "belum sync"), timesvc.drift_ppm);
+        w.printf_P(PSTR("🤖 AI Mode: %s"), mode_ai ? "ON" : "OFF");
+        tgClose(w);
+      }
     }
     else if (txt == "/dashboard") {
       String msg = "🌐 *Akses Dashboard*\n";
@@ -405,14 +646,24 @@ void handleTelegram(int n) {
       bot.sendMessage(cid, msg, "");
     }
     else if (txt == "/status" || txt == "/sensor") {
-      String msg = "🏥 *Laporan Kesehatan*\n";
-      msg += "🌡 " + String(t) + "C (Std: 18-30)\n";
-      msg += "💧 " + String(h) + "% (Std: 40-60)\n";
-      msg += "🔊 " + String(db) + "dB (Max: 55)\n";
-      msg += "💨 AQI: " + String(gas_mq135) + " (Max: 1000)\n";
-      msg += "🚭 Asap: " + String(smoke_detected ? "BAHAYA" : "AMAN") + "\n";
-      msg += "📊 Status: " + health_status;
-      bot.sendMessage(cid, msg, "");
+      ReplyWriter w(&client);
+      if (tgOpen(w, cid, "")) {
+        w.print(F("🏥 *Laporan Kesehatan*\n"));
+        w.printf_P(PSTR("🌡 %.2fC (Std: 18-30)\n"), t);
+        w.printf_P(PSTR("💧 %.2f%% (Std: 40-60)\n"), h);
+        w.printf_P(PSTR("🔊 %.2fdB (Max: 55)\n"), db);
+        w.printf_P(PSTR("💨 AQI: %d (Max: 1000)\n"), gas_mq135);
+        w.printf_P(PSTR("🚭 Asap: %s\n"), smoke_detected ? "BAHAYA" : "AMAN");
+        w.print(F("📊 Status: ")); w.print(health_status);
+        tgClose(w);
+      }
+    }
+    else if (txt == "/report") {
+      ReplyWriter w(&client);
+      if (tgOpen(w, cid, "Markdown")) {
+        writeReport(w, "📋 *Laporan Kepatuhan (Hari Ini)*", true);
+        tgClose(w);
+      }
     }
     else if (txt == "/download") {
       String msg = "📂 *Download Data*\n";
@@ -423,20 +674,20 @@ void handleTelegram(int n) {
     else if (txt == "/musik") {
       String msg = "🎵 *Daftar Lagu (Top 5)*\n";
       msg += "Ketik /music [nomor]\n\n";
-      msg += "26-28: Bel Sekolah\n";
-      msg += "29: Indonesia Raya\n";
-      msg += "32: Butterfly\n";
-      msg += "33: Mario Long\n";
-      msg += "37: Nyan Cat";
+      msg += "25-27: Bel Sekolah\n";
+      msg += "28: Indonesia Raya\n";
+      msg += "31: Butterfly\n";
+      msg += "32: Mario Long\n";
+      msg += "36: Nyan Cat";
       bot.sendMessage(cid, msg, "");
     }
     else if (txt == "/ai on") { mode_ai=true; bot.sendMessage(cid, "AI ON", ""); }
     else if (txt == "/ai off") { mode_ai=false; bot.sendMessage(cid, "AI OFF", ""); }
     else if (txt.startsWith("/music ")) {
-      playSong(txt.substring(7).toInt());
-      bot.sendMessage(cid, "Playing Song #" + txt.substring(7), "");
+      if (playSong(txt.substring(7).toInt(), PRIO_MUSIC)) bot.sendMessage(cid, "Playing Song #" + txt.substring(7), "");
+      else bot.sendMessage(cid, "Nomor lagu 0-" + String(SONG_COUNT - 1), "");
     }
-    else if (txt == "/stop") { is_playing = false; ledcWriteTone(PWM_CHANNEL, 0); bot.sendMessage(cid, "Stopped", ""); }
+    else if (txt == "/stop") { playStopMusic(); bot.sendMessage(cid, "Stopped", ""); }
     else if (txt.startsWith("/set_id")) {
        // Secret command to change admin ID via chat
        // String new_id = txt.substring(8);
@@ -448,14 +699,287 @@ void handleTelegram(int n) {
 }
 
 void handleJson() {
+  powerTouch();
   JsonDocument doc;
   doc["t"] = t; doc["h"] = h; doc["gas"] = gas_mq135; doc["mq2"] = gas_mq2; doc["db"] = db;
-  doc["rssi"] = rssi; doc["fan"] = st_fan; doc["lamp"] = st_lamp;
+  doc["rssi"] = rssi; doc["fan"] = st_fan; doc["fan_lvl"] = fan_level; doc["lamp"] = st_lamp;
+  doc["co2_f"] = vent.co2_forecast; doc["t_f"] = vent.temp_forecast;
   doc["ai"] = mode_ai; doc["bell"] = auto_bell; doc["mood"] = mood;
   doc["time"] = time_str; doc["ai_stat"] = ai_status; doc["health"] = health_status;
-  String json; serializeJson(doc, json);
+  JsonObject faults = doc["faults"].to<JsonObject>();
+  for (int ch = 0; ch < SENSOR_CHANNELS; ch++) {
+    if (sensorValid(ch)) continue;
+    doc[SENSOR_SPEC[ch].name] = nullptr; // Reading is not trustworthy
+    faults[SENSOR_SPEC[ch].name] = sensorFaultName(sensor_health[ch].fault);
+  }
+  doc["ts"] = (timesvc.sync == TIME_UNSYNCED) ? 0 : (uint32_t)(timeNowUs() / 1000000);
+  doc["time_sync"] = timesvc.sync; doc["time_err_ms"] = timeErrorMs(); doc["drift_ppm"] = timesvc.drift_ppm;
+  doc["occ"] = presence_detected; doc["occ_p"] = occ.prob; doc["occ_conf"] = occ.conf;
   server.sendHeader("Cache-Control", "no-cache, no-store");
-  server.send(200, "application/json", json);
+  httpStreamBegin("application/json");
+  ReplyWriter w(httpSink);
+  serializeJson(doc, w);
+  w.end();
+}
+
+// ================= STREAM WRITER =================
+// WebServer does the chunk framing; a zero-length chunk ends the reply.
+void httpSink(const char* data, size_t len) {
+  server.sendContent(data, len);
+}
+
+void httpStreamBegin(const char* type) {
+  server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  server.send(200, type, "");
+}
+
+// Telegram sendMessage streamed as a chunked JSON body over the bot's TLS
+// client. Everything written between tgOpen/tgClose becomes the "text" field.
+bool tgOpen(ReplyWriter &w, const String &cid, const char* parse_mode) {
+  client.stop(); // Drop the bot's keep-alive, this request owns the socket
+  if (!client.connect(TG_HOST, 443)) return false;
+  client.print(F("POST /bot")); client.print(bot_token);
+  client.print(F("/sendMessage HTTP/1.1\r\n"
+                 "Host: " TG_HOST "\r\n"
+                 "Content-Type: application/json\r\n"
+                 "Transfer-Encoding: chunked\r\n"
+                 "Connection: close\r\n\r\n"));
+  w.print(F("{\"chat_id\":\"")); w.print(cid);
+  w.print(F("\",\"parse_mode\":\"")); w.print(parse_mode);
+  w.print(F("\",\"text\":\""));
+  w.setEscape(true);
+  return true;
+}
+
+bool tgClose(ReplyWriter &w) {
+  w.setEscape(false);
+  w.print(F("\"}"));
+  w.end();
+
+  // Only the status line matters; the rest is discarded with the socket
+  char status[13] = {0};
+  size_t got = 0;
+  unsigned long start = millis();
+  while (got < 12 && millis() - start < TG_REPLY_TIMEOUT) {
+    if (client.available()) status[got++] = client.read();
+    else delay(5);
+  }
+  client.stop();
+  return strncmp(status + 9, "200", 3) == 0;
+}
+
+// ================= HISTORY STORE =================
+void updateHistory() {
+  if (timesvc.sync == TIME_UNSYNCED) return; // No wall clock to stamp with
+  histRoll(hist, timeNowUs() / 1000000);
+
+  // Same order as HIST_FIELD
+  if (sensorValid(CH_TEMP))  histAdd(hist, 0, t);
+  if (sensorValid(CH_HUMID)) histAdd(hist, 1, h);
+  if (sensorValid(CH_MQ135)) histAdd(hist, 2, gas_mq135);
+  if (sensorValid(CH_MQ2))   histAdd(hist, 3, gas_mq2);
+  if (sensorValid(CH_SOUND)) histAdd(hist, 4, db);
+  if (sensorValid(CH_LDR))   histAdd(hist, 5, lux);
+  histAdd(hist, 6, presence_detected ? 1 : 0);
+  histAdd(hist, 7, fan_level);
+}
+
+// ================= OTA UPDATE =================
+// Arduino core hook: keep the new image in PENDING_VERIFY instead of
+// marking it valid at boot, so otaHealthCheck() decides. The weak default
+// lives in esp32-hal-misc.c, so this must have C linkage to replace it.
+extern "C" bool verifyRollbackLater() { return true; }
+
+// Per-device secret, generated once and kept in NVS. Only shown on the
+// serial console, so flashing needs the key or physical access.
+void otaKeyInit() {
+  ota_key = pref.getString("ota_key", "");
+  if (ota_key.length() != OTA_KEY_LEN) {
+    char k[OTA_KEY_LEN + 1];
+    for (int i = 0; i < OTA_KEY_LEN / 8; i++) snprintf(k + i * 8, 9, "%08lx", (unsigned long)esp_random());
+    ota_key = k;
+    pref.putString("ota_key", ota_key);
+  }
+  Serial.print("OTA key: "); Serial.println(ota_key);
+}
+
+bool otaStart(const String &url, const String &sha_hex) {
+  if (ota.state == OTA_DOWNLOADING) { otaSetError(ota, "Busy"); return false; }
+  uint8_t expected[32];
+  if (!otaParseSha(sha_hex.c_str(), expected)) { otaSetError(ota, "sha256 must be 64 hex chars"); return false; }
+
+  ota_http.begin(url);
+  ota_http.setTimeout(5000);
+  int code = ota_http.GET();
+  if (code != HTTP_CODE_OK) {
+    ota_http.end();
+    snprintf(ota.error, sizeof(ota.error), "HTTP %d", code);
+    ota.state = OTA_FAILED;
+    return false;
+  }
+  if (!otaJobBegin(ota, &ota_flash, ota_http.getStreamPtr(), ota_http.getSize(), expected, millis())) {
+    ota_http.end();
+    return false;
+  }
+  return true;
+}
+
+void otaStep() {
+  if (ota.state == OTA_DONE && ota_reboot_at && millis() > ota_reboot_at) ESP.restart();
+  if (ota.state != OTA_DOWNLOADING) return;
+
+  otaJobStep(ota, millis());
+  if (ota.state == OTA_DOWNLOADING) return;
+  ota_http.end();
+  if (ota.state != OTA_DONE) return;
+  ota_reboot_at = millis() + 3000; // Let /ota report DONE first
+  bot.sendMessage(chat_id, "⬆️ Firmware terverifikasi, restart...", "");
+}
+
+// New image must stay up with WiFi for OTA_HEALTH_MIN_MS; otherwise the
+// bootloader switches back to the previous partition.
+void otaHealthCheck() {
+  if (!ota_pending_verify) return;
+  unsigned long up = millis();
+  if (up > OTA_HEALTH_MIN_MS && WiFi.status() == WL_CONNECTED) {
+    esp_ota_mark_app_valid_cancel_rollback();
+    ota_pending_verify = false;
+    bot.sendMessage(chat_id, "✅ Firmware baru OK", "");
+  } else if (up > OTA_HEALTH_MAX_MS) {
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+  }
+}
+
+// ================= TIME SERVICE =================
+// SNTP task context: just hand the sample over to loop(). The 64-bit pair
+// is not written atomically, so both sides take ntp_mux.
+void onNtpSync(struct timeval* tv) {
+  int64_t mono = esp_timer_get_time();
+  portENTER_CRITICAL(&ntp_mux);
+  ntp_wall_us = (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+  ntp_mono_us = mono;
+  ntp_pending = true;
+  portEXIT_CRITICAL(&ntp_mux);
+}
+
+int64_t timeNowUs() {
+  return timeAt(timesvc, esp_timer_get_time());
+}
+
+uint32_t timeErrorMs() {
+  return timeErrorMs(timesvc, esp_timer_get_time());
+}
+
+void updateTime() {
+  bool got = false;
+  int64_t wall = 0, mono = 0;
+  portENTER_CRITICAL(&ntp_mux);
+  if (ntp_pending) {
+    ntp_pending = false;
+    wall = ntp_wall_us; mono = ntp_mono_us;
+    got = true;
+  }
+  portEXIT_CRITICAL(&ntp_mux);
+  if (got) {
+    timeApplySync(timesvc, wall, mono);
+    time_next_minute = 0; // Re-derive broken-down time on the next tick
+  }
+  timeUpdateState(timesvc, esp_timer_get_time());
+  if (timesvc.sync == TIME_UNSYNCED) return;
+
+  // Broken-down time only changes on minute boundaries (or after a step)
+  time_t now_s = timeNowUs() / 1000000;
+  if (now_s < time_next_minute && now_s >= time_next_minute - 60) return;
+
+  struct tm tm_now;
+  localtime_r(&now_s, &tm_now);
+  strftime(time_str, sizeof(time_str), "%H:%M", &tm_now);
+  current_hour = tm_now.tm_hour;
+  current_minute = tm_now.tm_min;
+  current_yday = tm_now.tm_yday;
+  is_day_time = (current_hour >= 7 && current_hour < 17);
+  time_next_minute = now_s - tm_now.tm_sec + 60;
+
+  checkBellSchedule();
+}
+
+// ================= POWER MANAGER =================
+void powerTouch() {
+  last_http = millis();
+}
+
+// Milliseconds until the earliest loop() timer is due
+unsigned long powerNextDeadline() {
+  unsigned long now = millis();
+  unsigned long due[] = {
+    last_dht + DHT_INTERVAL_MS + 1, // loop() fires on "> interval"
+    sense_now ? now : last_analog + ANALOG_INTERVAL_MS + 1,
+    (WiFi.status() == WL_CONNECTED) ? last_bot + BOT_INTERVAL_MS + 1 : now + POWER_MAX_SLEEP_MS
+  };
+  unsigned long wait = powerWait(due, 3, now, POWER_MAX_SLEEP_MS);
+  // Bell minute boundary (also covered by the analog tick, kept for clarity)
+  if (timesvc.sync != TIME_UNSYNCED) {
+    int64_t left_ms = ((int64_t)time_next_minute * 1000000 - timeNowUs()) / 1000;
+    if (left_ms < (int64_t)wait) wait = left_ms > 0 ? left_ms : 0;
+  }
+  return wait;
+}
+
+void powerEnter(PowerState st) {
+  if (!powerAccount(power, st, esp_timer_get_time())) return;
+  // Frequency and radio follow the awake state; light sleep keeps whatever
+  // was set. Max modem sleep skips beacons: replies up to ~300 ms slower.
+  if (st == POWER_ACTIVE) {
+    setCpuFrequencyMhz(CPU_MHZ_ACTIVE);
+    WiFi.setSleep(WIFI_PS_MIN_MODEM);
+  } else if (st == POWER_IDLE) {
+    setCpuFrequencyMhz(CPU_MHZ_IDLE);
+    WiFi.setSleep(WIFI_PS_MAX_MODEM);
+  }
+}
+
+// Busy = full clock. Empty room = low clock. Empty at night with nothing
+// due for a while = light sleep until the next timer, or until the sound
+// pin goes HIGH. The fan's LEDC and the buzzer stop in light sleep, so both
+// count as busy.
+void powerManage() {
+  bool busy = presence_detected || player.playing || fan_level > 0 || smoke_detected || alert_active
+           || ota.state == OTA_DOWNLOADING || ota_pending_verify
+           || millis() - last_http < POWER_HTTP_GRACE_MS;
+  if (soundWakeUpdate(sound_wake, busy, millis())) power.spurious_wakes++;
+
+  bool wifi_up = WiFi.status() == WL_CONNECTED;
+  unsigned long wait = (busy || is_day_time) ? 0 : powerNextDeadline();
+  PowerState st = powerDecide(busy, is_day_time, wifi_up, wait);
+  if (st != POWER_SLEEP) { powerEnter(st); return; }
+
+  esp_sleep_enable_timer_wakeup((uint64_t)wait * 1000);
+  // Ultrasonic needs a trigger pulse, so only sound can wake us. The ADC
+  // pin has its digital input off; read it as a digital input first.
+  pinMode(PIN_SOUND, INPUT);
+  bool sound_armed = soundWakeArm(sound_wake, sensorValid(CH_SOUND), digitalRead(PIN_SOUND) == LOW, millis());
+  if (sound_armed) esp_sleep_enable_ext0_wakeup((gpio_num_t)PIN_SOUND, 1);
+
+  // The association does not survive light sleep: leave cleanly, rejoin
+  // after. The Telegram client redoes its TLS handshake on the next poll.
+  WiFi.mode(WIFI_OFF);
+  powerEnter(POWER_SLEEP);
+  esp_light_sleep_start();
+  power.sleeps++;
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(ssid_name.c_str(), ssid_pass.c_str());
+  if (sound_armed) {
+    esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_EXT0);
+    rtc_gpio_deinit((gpio_num_t)PIN_SOUND); // ext0 left the pad on the RTC mux
+  }
+  pinMode(PIN_SOUND, ANALOG);
+
+  if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_EXT0) {
+    power.sound_wakes++;
+    soundWakeFired(sound_wake, millis());
+    sense_now = true; // Without moving the timers out of step
+  }
+  powerEnter(POWER_IDLE);
 }
 
 // ================= UTILS =================
@@ -463,6 +987,9 @@ void handleJson() {
 void readDHT() {
   float _t = dht.readTemperature();
   float _h = dht.readHumidity();
+  sensorCheck(CH_TEMP, _t);
+  sensorCheck(CH_HUMID, _h);
+  // Last good value is kept; sensor_health says whether it is still usable
   if (!isnan(_t)) t = _t;
   if (!isnan(_h)) h = _h;
 }
@@ -471,6 +998,9 @@ void readAnalogSensors() {
   gas_mq135 = smoothAnalog(PIN_MQ135);
   gas_mq2   = smoothAnalog(PIN_MQ2);
   lux = smoothAnalog(PIN_LDR);
+  sensorCheck(CH_MQ135, gas_mq135);
+  sensorCheck(CH_MQ2, gas_mq2);
+  sensorCheck(CH_LDR, lux);
 
   digitalWrite(PIN_TRIG, LOW); delayMicroseconds(2);
   digitalWrite(PIN_TRIG, HIGH); delayMicroseconds(10);
@@ -478,7 +1008,9 @@ void readAnalogSensors() {
   long dur = pulseIn(PIN_ECHO, HIGH, 30000);
   dist = (dur == 0) ? 0 : dur * 0.034 / 2;
 
-  db = (smoothAnalog(PIN_SOUND) / 4095.0) * 100.0;
+  int sound_raw = smoothAnalog(PIN_SOUND);
+  sensorCheck(CH_SOUND, sound_raw);
+  db = (sound_raw / 4095.0) * 100.0;
   rssi = WiFi.RSSI();
 }
 
@@ -488,16 +1020,6 @@ int smoothAnalog(int pin) {
   return total / 5;
 }
 
-void updateTime() {
-  struct tm timeinfo;
-  if(!getLocalTime(&timeinfo)){ time_str = "--:--"; return; }
-  char b[10]; strftime(b, sizeof(b), "%H:%M", &timeinfo);
-  time_str = String(b);
-  current_hour = timeinfo.tm_hour;
-  current_minute = timeinfo.tm_min;
-  is_day_time = (current_hour >= 7 && current_hour < 17);
-}
-
 void handleScanWiFi() {
   int n = WiFi.scanComplete();
   if (n == -2) {
@@ -530,9 +1052,85 @@ void checkWiFi() {
 }
 
 void handleDownload() {
-  String csv = "Time,T,H,Gas,Smoke,DB\n" + String(millis()) + "," + String(t) + "," + String(h) + "," + String(gas_mq135) + "," + String(gas_mq2) + "," + String(db);
   server.sendHeader("Content-Disposition", "attachment; filename=log.csv");
-  server.send(200, "text/csv", csv);
+  httpStreamBegin("text/csv");
+  ReplyWriter w(httpSink);
+  w.print(F("Time,T,H,Gas,Smoke,DB\n"));
+  w.printf_P(PSTR("%lu,%.2f,%.2f,%d,%d,%.2f"), millis(), t, h, gas_mq135, gas_mq2, db);
+  w.end();
+}
+
+void handleReport() {
+  server.sendHeader("Cache-Control", "no-cache, no-store");
+  httpStreamBegin("text/plain; charset=utf-8");
+  ReplyWriter w(httpSink);
+  writeReport(w, "Laporan Kepatuhan (Hari Ini)", false);
+  w.end();
+}
+
+// GET /ota: status. POST /ota url=&sha256= with header X-OTA-Key: starts a
+// download. The custom header also keeps cross-site forms out (CORS is on).
+void handleOta() {
+  if (server.method() == HTTP_POST) {
+    if (!otaKeyMatch(server.header("X-OTA-Key").c_str(), ota_key.c_str())) {
+      server.send(403, "text/plain", "Bad OTA key");
+      return;
+    }
+    if (!server.hasArg("url")) { server.send(400, "text/plain", "Missing url"); return; }
+    otaStart(server.arg("url"), server.arg("sha256"));
+  }
+
+  static const char* const STATES[] = {"idle", "downloading", "done", "failed"};
+  JsonDocument doc;
+  doc["state"] = STATES[ota.state]; doc["written"] = ota.written; doc["total"] = ota.total;
+  doc["error"] = ota.error; doc["pending_verify"] = ota_pending_verify;
+  server.sendHeader("Cache-Control", "no-cache, no-store");
+  httpStreamBegin("application/json");
+  ReplyWriter w(httpSink);
+  serializeJson(doc, w);
+  w.end();
+}
+
+// GET /api/v2/history?from=&to=&step=&fields=t,h,...
+// from/to are Unix seconds, step is rounded up to whole HIST_INTERVAL_S.
+// Rows are [ts, field...] averaged per step, streamed as chunked JSON.
+void handleHistory() {
+  uint32_t now_s = (timesvc.sync == TIME_UNSYNCED) ? 0 : timeNowUs() / 1000000;
+  uint32_t to = server.hasArg("to") ? strtoul(server.arg("to").c_str(), nullptr, 10) : now_s;
+  uint32_t from = server.hasArg("from") ? strtoul(server.arg("from").c_str(), nullptr, 10)
+                                        : (to > HIST_DEFAULT_SPAN_S ? to - HIST_DEFAULT_SPAN_S : 0);
+  uint32_t step = histStep(server.hasArg("step") ? strtoul(server.arg("step").c_str(), nullptr, 10) : HIST_INTERVAL_S);
+
+  uint8_t mask = histFieldMask(server.arg("fields").c_str());
+  if (mask == 0) { server.send(400, "text/plain", "Unknown fields"); return; }
+
+  server.sendHeader("Cache-Control", "no-cache, no-store");
+  httpStreamBegin("application/json");
+  ReplyWriter w(httpSink);
+  histQuery(hist, w, from, to, step, mask);
+  w.end();
+}
+
+// Prometheus text format
+void handleMetrics() {
+  powerEnter(power.state); // Bring the current state's time up to date
+  static const char* const STATES[POWER_STATES] = {"active", "idle", "sleep"};
+  httpStreamBegin("text/plain; version=0.0.4");
+  ReplyWriter w(httpSink);
+  w.print(F("# HELP smartclass_power_seconds_total Time spent in each power state.\n"
+            "# TYPE smartclass_power_seconds_total counter\n"));
+  for (int st = 0; st < POWER_STATES; st++) {
+    w.printf_P(PSTR("smartclass_power_seconds_total{state=\"%s\"} %.3f\n"), STATES[st], power.time_us[st] / 1e6);
+  }
+  w.print(F("# TYPE smartclass_light_sleeps_total counter\n"));
+  w.printf_P(PSTR("smartclass_light_sleeps_total %lu\n"), (unsigned long)power.sleeps);
+  w.print(F("# TYPE smartclass_sound_wakes_total counter\n"));
+  w.printf_P(PSTR("smartclass_sound_wakes_total %lu\n"), (unsigned long)power.sound_wakes);
+  w.print(F("# TYPE smartclass_spurious_wakes_total counter\n"));
+  w.printf_P(PSTR("smartclass_spurious_wakes_total %lu\n"), (unsigned long)power.spurious_wakes);
+  w.print(F("# TYPE smartclass_cpu_mhz gauge\n"));
+  w.printf_P(PSTR("smartclass_cpu_mhz %lu\n"), (unsigned long)getCpuFrequencyMhz());
+  w.end();
 }
 
 void handleSaveSettings() {
@@ -549,6 +1147,7 @@ void handleSaveSettings() {
 }
 
 void handleRoot() {
+  powerTouch();
   server.sendHeader("Cache-Control", "no-cache");
   server.setContentLength(CONTENT_LENGTH_UNKNOWN);
   server.send(200, "text/html", "");
@@ -0,0 +1,82 @@
+#ifndef COMPLIANCE_H
+#define COMPLIANCE_H
+
+#include "Arduino.h"
+#include "reply_writer.h"
+
+// ================= COMPLIANCE STATISTICS =================
+// All values fixed-point x10 (26.5 C -> 265). One histogram per metric
+// gives P50/P95 in O(1) memory; one sample per second of class time.
+#define STAT_BUCKETS    64
+
+struct MetricSpec {
+  const char* name;
+  const char* unit;
+  int32_t lo, hi;        // Allowed range (x10)
+  int32_t bucket_w;      // Histogram bucket width (x10), starts at 0
+};
+
+struct MetricStats {
+  uint32_t samples;      // Seconds observed
+  uint32_t in_range;     // Seconds inside [lo, hi]
+  uint32_t exceed_count; // Separate exceedance episodes
+  uint32_t exceed_cur;   // Current episode length (s)
+  uint32_t exceed_max;   // Longest episode today (s)
+  uint32_t hist[STAT_BUCKETS]; // Same width as samples, so ranks never saturate
+};
+
+inline void statAdd(MetricStats &st, const MetricSpec &sp, int32_t v10) {
+  st.samples++;
+
+  if (v10 >= sp.lo && v10 <= sp.hi) {
+    st.in_range++;
+    st.exceed_cur = 0;
+  } else {
+    if (st.exceed_cur == 0) st.exceed_count++;
+    st.exceed_cur++;
+    if (st.exceed_cur > st.exceed_max) st.exceed_max = st.exceed_cur;
+  }
+
+  int32_t b = v10 / sp.bucket_w;
+  b = constrain(b, 0, STAT_BUCKETS - 1);
+  st.hist[b]++;
+}
+
+// Linear interpolation inside the bucket holding the requested rank.
+// Exact to within one bucket_w for values inside [0, STAT_BUCKETS * bucket_w).
+inline int32_t statPercentile(const MetricStats &st, const MetricSpec &sp, int pct) {
+  if (st.samples == 0) return 0;
+  uint32_t rank = ((uint64_t)pct * st.samples + 99) / 100; // 1-based
+  uint32_t seen = 0;
+  for (int b = 0; b < STAT_BUCKETS; b++) {
+    if (st.hist[b] == 0) continue;
+    if (seen + st.hist[b] >= rank) {
+      int32_t w = sp.bucket_w;
+      return b * w + (int32_t)((int64_t)(2 * (rank - seen) - 1) * w / (2 * (int64_t)st.hist[b]));
+    }
+    seen += st.hist[b];
+  }
+  return (STAT_BUCKETS - 1) * sp.bucket_w;
+}
+
+// Daily report. markdown: bold metric names for Telegram; /report is text/plain.
+// class_s is counted separately: a faulted sensor has no samples but the
+// class was still in session.
+inline void statReport(ReplyWriter &out, const MetricStats *stats, const MetricSpec *spec, int n,
+                       uint32_t class_s, const char* title, bool markdown) {
+  out.print(title); out.print("\n");
+  for (int m = 0; m < n; m++) {
+    const MetricStats &st = stats[m];
+    const MetricSpec &sp = spec[m];
+    out.print(markdown ? "\n*" : "\n"); out.print(sp.name); out.print(markdown ? "*: " : ": ");
+    if (st.samples == 0) { out.print("belum ada data\n"); continue; }
+    uint32_t pct10 = (uint64_t)st.in_range * 1000 / st.samples;
+    int32_t p50 = statPercentile(st, sp, 50), p95 = statPercentile(st, sp, 95);
+    out.printf_P(PSTR("%u.%u%% sesuai standar\n"), (unsigned)(pct10 / 10), (unsigned)(pct10 % 10));
+    out.printf_P(PSTR("P50 %d.%d / P95 %d.%d %s\n"), (int)(p50 / 10), (int)(p50 % 10), (int)(p95 / 10), (int)(p95 % 10), sp.unit);
+    out.printf_P(PSTR("Lewat batas: %ux, terlama %u mnt\n"), (unsigned)st.exceed_count, (unsigned)(st.exceed_max / 60));
+  }
+  out.printf_P(PSTR("\n⏱️ Jam pelajaran terpantau: %uj %um"), (unsigned)(class_s / 3600), (unsigned)((class_s / 60) % 60));
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "Arduino.h"
+#include "reply_writer.h"
+
+// ================= HISTORY STORE =================
+// 7 days at 5-minute resolution, 20 bytes/sample -> ~40 KB of RAM. The
+// sketch feeds readings and stamps intervals with the wall clock passed in;
+// tests/ fills a week and times the queries on the host.
+#define HIST_SIZE       2016
+#define HIST_FIELDS     8
+#define HIST_NONE       INT16_MIN // No valid reading during the interval
+const uint32_t HIST_INTERVAL_S = 300;
+const uint32_t HIST_DEFAULT_SPAN_S = 86400; // /api/v2/history without from=
+
+struct HistField {
+  const char* name;
+  float scale;      // Stored as int16 = value * scale
+  uint8_t decimals; // In the JSON output
+};
+const HistField HIST_FIELD[HIST_FIELDS] = {
+  {"t", 10, 1}, {"h", 10, 1}, {"gas", 1, 0}, {"mq2", 1, 0},
+  {"db", 10, 1}, {"lux", 1, 0}, {"occ", 100, 2}, {"fan", 100, 2}
+};
+
+struct HistSample {
+  uint32_t ts;              // Unix seconds, start of the interval
+  int16_t v[HIST_FIELDS];   // See HIST_FIELD for scale
+};
+
+// Ring of interval means, oldest overwritten
+struct HistStore {
+  HistSample buf[HIST_SIZE];
+  int head;                 // Next slot to write
+  int count;
+  uint32_t slot;            // Interval currently being accumulated
+  float sum[HIST_FIELDS];
+  uint16_t n[HIST_FIELDS];
+};
+
+inline void histAdd(HistStore &hs, int f, float v) {
+  hs.sum[f] += v;
+  hs.n[f]++;
+}
+
+// i = 0 is the oldest sample
+inline const HistSample& histAt(const HistStore &hs, int i) {
+  int k = hs.head - hs.count + i;
+  return hs.buf[k < 0 ? k + HIST_SIZE : k];
+}
+
+// First sample with ts >= given time (count if none); timestamps only grow
+inline int histLowerBound(const HistStore &hs, uint32_t ts) {
+  int lo = 0, hi = hs.count;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (histAt(hs, mid).ts < ts) lo = mid + 1; else hi = mid;
+  }
+  return lo;
+}
+
+// Call before histAdd() each tick: when the interval has rolled over,
+// stores the means of what was valid and starts the next one
+inline void histRoll(HistStore &hs, uint32_t now_s) {
+  uint32_t slot = now_s - now_s % HIST_INTERVAL_S;
+  if (slot == hs.slot) return;
+
+  bool any = false;
+  for (int f = 0; f < HIST_FIELDS; f++) any |= (hs.n[f] > 0);
+  // A clock step backwards must not break the ordering histLowerBound needs
+  if (any && hs.slot > (hs.count ? histAt(hs, hs.count - 1).ts : 0)) {
+    HistSample &s = hs.buf[hs.head];
+    s.ts = hs.slot;
+    for (int f = 0; f < HIST_FIELDS; f++) {
+      s.v[f] = hs.n[f] ? (int16_t)lroundf(hs.sum[f] / hs.n[f] * HIST_FIELD[f].scale) : HIST_NONE;
+    }
+    hs.head = (hs.head + 1) % HIST_SIZE;
+    if (hs.count < HIST_SIZE) hs.count++;
+  }
+  memset(hs.sum, 0, sizeof(hs.sum));
+  memset(hs.n, 0, sizeof(hs.n));
+  hs.slot = slot;
+}
+
+// Requested step rounded up to whole intervals, at most the whole store
+inline uint32_t histStep(uint32_t step) {
+  step = constrain(step, HIST_INTERVAL_S, HIST_SIZE * HIST_INTERVAL_S);
+  return (step + HIST_INTERVAL_S - 1) / HIST_INTERVAL_S * HIST_INTERVAL_S;
+}
+
+// "t,h,db" -> field bitmask; empty = all, whole names only ("h" must not
+// hit "mq2"), unknown names are ignored
+inline uint8_t histFieldMask(const char* fl) {
+  if (!fl || !*fl) return (1 << HIST_FIELDS) - 1;
+  uint8_t mask = 0;
+  while (*fl) {
+    const char* end = strchr(fl, ',');
+    size_t len = end ? (size_t)(end - fl) : strlen(fl);
+    for (int f = 0; f < HIST_FIELDS; f++) {
+      if (strlen(HIST_FIELD[f].name) == len && strncmp(HIST_FIELD[f].name, fl, len) == 0) mask |= (1 << f);
+    }
+    fl += len;
+    if (*fl) fl++;
+  }
+  return mask;
+}
+
+// Streams {"from","to","step","fields":["ts",...],"rows":[[ts,v,...],...]}.
+// step is a multiple of HIST_INTERVAL_S; rows average the samples of each
+// step bucket, null where a field had no valid reading. Integer sums: a
+// week of int16 fits an int32 exactly.
+inline void histQuery(const HistStore &hs, ReplyWriter &w, uint32_t from, uint32_t to, uint32_t step, uint8_t mask) {
+  w.printf_P(PSTR("{\"from\":%lu,\"to\":%lu,\"step\":%lu,\"fields\":[\"ts\""),
+             (unsigned long)from, (unsigned long)to, (unsigned long)step);
+  for (int f = 0; f < HIST_FIELDS; f++) {
+    if (mask & (1 << f)) w.printf_P(PSTR(",\"%s\""), HIST_FIELD[f].name);
+  }
+  w.print(F("],\"rows\":["));
+
+  // One pass over the range, flushing a row each time the step bucket changes
+  int32_t sum[HIST_FIELDS];
+  uint16_t n[HIST_FIELDS];
+  uint32_t bucket = 0;
+  bool open = false, first = true;
+  for (int i = histLowerBound(hs, from); i <= hs.count; i++) {
+    const HistSample *s = (i < hs.count) ? &histAt(hs, i) : nullptr;
+    bool done = !s || s->ts > to;
+    uint32_t b = done ? 0 : s->ts - s->ts % step;
+    if (open && (done || b != bucket)) {
+      w.printf_P(PSTR("%s[%lu"), first ? "" : ",", (unsigned long)bucket);
+      for (int f = 0; f < HIST_FIELDS; f++) {
+        if (!(mask & (1 << f))) continue;
+        if (n[f]) w.printf_P(PSTR(",%.*f"), HIST_FIELD[f].decimals, (float)sum[f] / n[f] / HIST_FIELD[f].scale);
+        else w.print(F(",null"));
+      }
+      w.print(']');
+      first = false;
+      open = false;
+    }
+    if (done) break;
+    if (!open) {
+      memset(sum, 0, sizeof(sum));
+      memset(n, 0, sizeof(n));
+      bucket = b;
+      open = true;
+    }
+    for (int f = 0; f < HIST_FIELDS; f++) {
+      if (s->v[f] == HIST_NONE) continue;
+      sum[f] += s->v[f];
+      n[f]++;
+    }
+  }
+  w.print(F("]}"));
+}
+
+#endif
@@ -36,6 +36,7 @@ const char HTML_HEAD[] PROGMEM = R"=====(
     .card h3 { margin: 0 0 5px 0; font-size: 0.75rem; color: #94a3b8; text-transform: uppercase; letter-spacing: 1px; }
     .val { font-size: 1.8rem; font-weight: 800; }
     .unit { font-size: 0.8rem; color: #64748b; }
+    .spark { display: block; width: 100%; height: 28px; margin-top: 6px; }
 
     .ref { font-size: 0.65rem; color: #64748b; display: block; margin-top: 5px; text-decoration: none; border-top: 1px solid rgba(255,255,255,0.05); padding-top: 5px; }
     .ref:hover { color: var(--primary); }
@@ -103,21 +104,25 @@ const char HTML_BODY[] PROGMEM = R"=====(
       <div class="card">
         <h3>Suhu (KEMENKES)</h3>
         <div class="val" id="t">--</div><span class="unit">°C</span>
+        <canvas class="spark" id="sp_t" width="120" height="28"></canvas>
         <a href="https://peraturan.bpk.go.id/Details/258908/permenkes-no-2-tahun-2023" target="_blank" class="ref">Std: 18-30°C (PMK 2/2023)</a>
       </div>
       <div class="card">
         <h3>Lembab (KEMENKES)</h3>
         <div class="val" id="h">--</div><span class="unit">%</span>
+        <canvas class="spark" id="sp_h" width="120" height="28"></canvas>
         <a href="https://peraturan.bpk.go.id/Details/258908/permenkes-no-2-tahun-2023" target="_blank" class="ref">Std: 40-60% (PMK 2/2023)</a>
       </div>
       <div class="card">
         <h3>Suara (KEPMEN LH)</h3>
         <div class="val" id="db">--</div><span class="unit">dB</span>
+        <canvas class="spark" id="sp_db" width="120" height="28"></canvas>
         <a href="https://peraturan.go.id/id/kepmen-lh-no-48-tahun-1996" target="_blank" class="ref">Max: 55dB (No.48/1996)</a>
       </div>
       <div class="card">
         <h3>Udara (WHO)</h3>
         <div class="val" id="gas">--</div><span class="unit">PPM</span>
+        <canvas class="spark" id="sp_gas" width="120" height="28"></canvas>
         <a href="https://www.ncbi.nlm.nih.gov/books/NBK138705/" target="_blank" class="ref">CO2 &lt; 1000 (Ventilasi)</a>
       </div>
 
@@ -288,30 +293,76 @@ const char HTML_BODY[] PROGMEM = R"=====(
     }
     function cmd(a) { fetch('/cmd?do='+a).then(update); }
 
+    // Diffing renderer: a node is only written when its value changed
+    var E = {}, V = {};
+    function $(id) { return E[id] || (E[id] = document.getElementById(id)); }
+    function set(id, p, v) {
+      var k = id + '.' + p;
+      if (V[k] === v) return;
+      V[k] = v; $(id)[p] = v;
+    }
+    function fx(v, d) { return v == null ? '--' : v.toFixed(d); } // null = sensor fault
+
+    // Sparklines: one fixed ring per metric, 10 min buckets over 24 h
+    var STEP = 600, N = 144, KEYS = ['t', 'h', 'gas', 'db'], R = {};
+    KEYS.forEach(k => R[k] = { v: new Array(N).fill(null), head: 0, slot: 0, n: 0, dirty: false });
+
+    function push(k, ts, v) {
+      var r = R[k], s = ts - ts % STEP;
+      if (s < r.slot) return; // Older than what we have
+      if (s > r.slot) {
+        var gap = r.slot ? Math.min(N, (s - r.slot) / STEP) : 1;
+        while (gap--) { r.head = (r.head + 1) % N; r.v[r.head] = null; }
+        r.slot = s; r.n = 0; r.dirty = true;
+      }
+      if (v == null) return;
+      r.v[r.head] = (r.v[r.head] * r.n + v) / (r.n + 1); // Running bucket mean
+      r.n++; r.dirty = true;
+    }
+
+    function draw(k) {
+      var r = R[k]; if (!r.dirty) return; r.dirty = false;
+      var c = $('sp_' + k), g = c.getContext('2d'), w = c.width, h = c.height;
+      var lo = Infinity, hi = -Infinity, i, v, pen = false;
+      r.v.forEach(v => { if (v != null) { lo = Math.min(lo, v); hi = Math.max(hi, v); } });
+      g.clearRect(0, 0, w, h);
+      if (lo > hi) return;
+      if (hi - lo < 1e-6) { hi++; lo--; }
+      g.strokeStyle = '#6366f1'; g.lineWidth = 1.5; g.beginPath();
+      for (i = 0; i < N; i++) {
+        v = r.v[(r.head + 1 + i) % N];
+        if (v == null) { pen = false; continue; }
+        var x = i * (w - 1) / (N - 1), y = h - 1 - (v - lo) / (hi - lo) * (h - 2);
+        pen ? g.lineTo(x, y) : g.moveTo(x, y); pen = true;
+      }
+      g.stroke();
+    }
+
     function update() {
       fetch('/data?ts=' + Date.now()).then(r => r.json()).then(d => {
-        document.getElementById('t').innerText = d.t.toFixed(1);
-        document.getElementById('h').innerText = d.h.toFixed(0);
-        document.getElementById('gas').innerText = d.gas;
-        document.getElementById('db').innerText = d.db.toFixed(0);
-        document.getElementById('time').innerText = d.time;
-        document.getElementById('ip').innerText = window.location.hostname;
+        set('t', 'innerText', fx(d.t, 1));
+        set('h', 'innerText', fx(d.h, 0));
+        set('gas', 'innerText', fx(d.gas, 0));
+        set('db', 'innerText', fx(d.db, 0));
+        set('time', 'innerText', d.time);
 
         // Status Badges
-        document.getElementById('ai_status').innerText = d.ai ? "Active" : "Manual";
-        document.getElementById('ai_status').className = d.ai ? "badge ok" : "badge warn";
-
-        document.getElementById('health').innerText = d.health.includes("OK") ? "Normal" : "Warning";
-        document.getElementById('health').className = d.health.includes("OK") ? "badge ok" : "badge err";
-
-        document.getElementById('mq2_stat').innerText = d.mq2 > 2000 ? "ASAP!" : "Aman";
-        document.getElementById('mq2_stat').className = d.mq2 > 2000 ? "badge err" : "badge ok";
+        var ok = d.health.includes("OK"), smoke = d.mq2 > 2000;
+        set('ai_status', 'innerText', d.ai ? "Active" : "Manual");
+        set('ai_status', 'className', d.ai ? "badge ok" : "badge warn");
+        set('health', 'innerText', ok ? "Normal" : "Warning");
+        set('health', 'className', ok ? "badge ok" : "badge err");
+        set('mq2_stat', 'innerText', smoke ? "ASAP!" : "Aman");
+        set('mq2_stat', 'className', smoke ? "badge err" : "badge ok");
 
         // Buttons
-        document.getElementById('btn_fan').className = d.fan ? "btn-on active" : "btn-on";
-        document.getElementById('btn_lamp').className = d.lamp ? "btn-on active" : "btn-on";
-        document.getElementById('btn_ai').className = d.ai ? "btn-on active" : "btn-on";
-        document.getElementById('btn_bell').className = d.bell ? "btn-on active" : "btn-on";
+        set('btn_fan', 'className', d.fan ? "btn-on active" : "btn-on");
+        set('btn_lamp', 'className', d.lamp ? "btn-on active" : "btn-on");
+        set('btn_ai', 'className', d.ai ? "btn-on active" : "btn-on");
+        set('btn_bell', 'className', d.bell ? "btn-on active" : "btn-on");
+
+        var ts = d.ts || Math.floor(Date.now() / 1000);
+        KEYS.forEach(k => { push(k, ts, d[k]); draw(k); });
       });
     }
 
@@ -327,7 +378,17 @@ const char HTML_BODY[] PROGMEM = R"=====(
           });
        });
     }
-    setInterval(update, 2000); update();
+    // Seed the sparklines from the device store before live polling starts
+    function start() { setInterval(update, 2000); update(); }
+    set('ip', 'innerText', window.location.hostname);
+    fetch('/api/v2/history?step=' + STEP + '&fields=' + KEYS.join(','))
+      .then(r => r.json())
+      .then(d => {
+        var col = KEYS.map(k => d.fields.indexOf(k)); // Server order, not ours
+        d.rows.forEach(row => KEYS.forEach((k, j) => { if (col[j] > 0) push(k, row[0], row[col[j]]); }));
+      })
+      .catch(() => {})
+      .then(start);
   </script>
 </body>
 </html>
@@ -0,0 +1,96 @@
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include "Arduino.h"
+
+// ================= OCCUPANCY ESTIMATOR =================
+// Fuses ultrasonic, sound and light over sliding windows into P(occupied).
+// Pure logic (no pins, no globals) so tests/ can replay traces on the host.
+#define OCC_WINDOW      30    // Samples per window (1 tick/s -> 30 s)
+const float OCC_NEAR_CM     = 150.0; // Ultrasonic "someone at desk" range
+const float OCC_NO_ECHO_CM  = 400.0; // pulseIn timeout = nothing in range
+const float OCC_ON_PROB     = 0.70;  // Hysteresis: Empty -> Occupied
+const float OCC_OFF_PROB    = 0.30;  // Hysteresis: Occupied -> Empty
+const float OCC_ALPHA       = 0.15;  // Belief smoothing per tick
+
+struct RingStat {
+  float buf[OCC_WINDOW];
+  float sum;
+  float sum_sq;
+  int idx;
+  int count;
+};
+
+struct Occupancy {
+  RingStat near;       // 1.0 if echo inside OCC_NEAR_CM
+  RingStat dist;       // Distance (cm), for movement variance
+  RingStat sound;      // Sound level, for RMS
+  RingStat lux_delta;  // |lux - previous lux|, for light changes
+  float last_lux;
+  bool has_lux;
+  float prob;          // P(occupied)
+  float conf;          // 0..1, distance from the 50/50 point
+  bool present;        // Hysteresis output
+};
+
+// Running sums make push/mean/variance O(1) regardless of OCC_WINDOW.
+inline void ringPush(RingStat &r, float v) {
+  if (r.count == OCC_WINDOW) {
+    float old = r.buf[r.idx];
+    r.sum -= old; r.sum_sq -= old * old;
+  } else {
+    r.count++;
+  }
+  r.buf[r.idx] = v;
+  r.sum += v; r.sum_sq += v * v;
+  r.idx = (r.idx + 1) % OCC_WINDOW;
+}
+
+inline float ringMean(const RingStat &r) {
+  return r.count ? r.sum / r.count : 0;
+}
+
+inline float ringVar(const RingStat &r) {
+  if (r.count < 2) return 0;
+  float m = r.sum / r.count;
+  float v = r.sum_sq / r.count - m * m;
+  return v > 0 ? v : 0; // Float cancellation guard
+}
+
+// One tick. dist = 0 means no echo. Faulty sound/light channels are left
+// out of the fusion. Returns the (hysteresis) occupied state.
+inline bool occupancyUpdate(Occupancy &o, float dist, float db, float lux, bool sound_ok, bool light_ok) {
+  // 1. Feed windows (no echo = empty room, treat as max range)
+  float d = (dist > 0) ? dist : OCC_NO_ECHO_CM;
+  ringPush(o.near, (d < OCC_NEAR_CM) ? 1.0 : 0.0);
+  ringPush(o.dist, d);
+  if (sound_ok) ringPush(o.sound, db);
+  if (light_ok) {
+    if (o.has_lux) ringPush(o.lux_delta, fabs(lux - o.last_lux));
+    o.last_lux = lux;
+    o.has_lux = true;
+  }
+
+  // 2. Evidence per channel, each normalised to 0..1
+  float e_near  = ringMean(o.near);                          // Time someone is in range
+  float e_move  = constrain(sqrt(ringVar(o.dist)) / 40.0, 0.0, 1.0); // People fidget, desks don't
+  float rms     = sqrt(o.sound.count ? o.sound.sum_sq / o.sound.count : 0);
+  float e_sound = constrain((rms - 40.0) / 25.0, 0.0, 1.0);  // Sustained talk, not one truck
+  float e_light = constrain(ringMean(o.lux_delta) / 150.0, 0.0, 1.0); // Shadows, switching
+
+  // 3. Weighted fusion (faulty channels drop out) -> likelihood -> smoothed belief
+  float w_sound = sound_ok ? 0.25 : 0;
+  float w_light = light_ok ? 0.10 : 0;
+  float score = (0.40 * e_near + 0.25 * e_move + w_sound * e_sound + w_light * e_light)
+              / (0.65 + w_sound + w_light);
+  float p_tick = 1.0 / (1.0 + exp(-10.0 * (score - 0.35)));
+  o.prob += OCC_ALPHA * (p_tick - o.prob);
+  o.conf = fabs(o.prob - 0.5) * 2.0;
+
+  // 4. Hysteresis so the state does not chatter around 50%
+  if (!o.present && o.prob > OCC_ON_PROB) o.present = true;
+  else if (o.present && o.prob < OCC_OFF_PROB) o.present = false;
+  return o.present;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef OTA_H
+#define OTA_H
+
+#include "Arduino.h"
+#include <mbedtls/sha256.h>
+
+// ================= OTA UPDATE =================
+// Cooperative flasher: one chunk per otaJobStep(), so sensing and bells keep
+// running. The image is hashed while it streams and only committed when the
+// SHA-256 matches. Transport and flash are passed in, so tests/ can run it
+// against a local HTTP server and a RAM partition.
+#define OTA_CHUNK       1024  // Bytes flashed per loop() pass
+#define OTA_KEY_LEN     32    // Hex chars of the per-device secret (128 bit)
+const unsigned long OTA_STALL_MS = 15000;  // No data -> abort
+
+enum OtaState { OTA_IDLE, OTA_DOWNLOADING, OTA_DONE, OTA_FAILED };
+
+// Destination of the image: Update in the sketch, a RAM partition in tests/
+class OtaFlash {
+public:
+  virtual ~OtaFlash() {}
+  virtual bool begin(size_t size) = 0;
+  virtual size_t write(uint8_t* data, size_t len) = 0;
+  virtual bool end() = 0;
+  virtual void abort() = 0;
+  virtual const char* errorString() = 0;
+};
+
+struct OtaJob {
+  OtaState state;
+  OtaFlash* flash;
+  Stream* in;
+  mbedtls_sha256_context sha;
+  uint8_t expected[32];
+  uint8_t buf[OTA_CHUNK];
+  int total;
+  int written;
+  unsigned long last_data;
+  char error[48];
+};
+
+inline void otaSetError(OtaJob &j, const char* why) {
+  snprintf(j.error, sizeof(j.error), "%s", why);
+}
+
+// 64 hex chars -> 32 bytes
+inline bool otaParseSha(const char* hex, uint8_t out[32]) {
+  if (strlen(hex) != 64) return false;
+  for (int i = 0; i < 32; i++) {
+    char hx[3] = { hex[i * 2], hex[i * 2 + 1], 0 };
+    char* end;
+    out[i] = strtoul(hx, &end, 16);
+    if (*end) return false;
+  }
+  return true;
+}
+
+// Constant time in the key length, so response timing does not leak a prefix
+inline bool otaKeyMatch(const char* given, const char* key) {
+  size_t n = strlen(key), g = strlen(given);
+  uint8_t diff = (g != n || n == 0);
+  for (size_t i = 0; i < n; i++) diff |= key[i] ^ (i < g ? given[i] : 0);
+  return diff == 0;
+}
+
+inline bool otaJobBegin(OtaJob &j, OtaFlash* flash, Stream* in, int total,
+                        const uint8_t expected[32], unsigned long now) {
+  if (j.state == OTA_DOWNLOADING) { otaSetError(j, "Busy"); return false; }
+  if (total <= 0 || !flash->begin(total)) { // Targets the inactive OTA partition
+    otaSetError(j, total <= 0 ? "Unknown image size" : flash->errorString());
+    j.state = OTA_FAILED;
+    return false;
+  }
+  j.flash = flash;
+  j.in = in;
+  memcpy(j.expected, expected, 32);
+  mbedtls_sha256_init(&j.sha);
+  mbedtls_sha256_starts(&j.sha, 0); // 0 = SHA-256, not SHA-224
+  j.total = total;
+  j.written = 0;
+  j.last_data = now;
+  j.error[0] = 0;
+  j.state = OTA_DOWNLOADING;
+  return true;
+}
+
+inline void otaJobFail(OtaJob &j, const char* why) {
+  j.flash->abort();
+  mbedtls_sha256_free(&j.sha);
+  j.in = nullptr;
+  otaSetError(j, why);
+  j.state = OTA_FAILED;
+}
+
+// At most one OTA_CHUNK per call. Leaves state DONE or FAILED when finished.
+inline void otaJobStep(OtaJob &j, unsigned long now) {
+  if (j.state != OTA_DOWNLOADING) return;
+
+  int avail = j.in->available();
+  if (avail <= 0) {
+    if (now - j.last_data > OTA_STALL_MS) otaJobFail(j, "Download stalled");
+    return;
+  }
+
+  int want = min(min(avail, OTA_CHUNK), j.total - j.written);
+  int n = j.in->readBytes(j.buf, want);
+  if (n <= 0) return;
+  j.last_data = now;
+  mbedtls_sha256_update(&j.sha, j.buf, n);
+  if (j.flash->write(j.buf, n) != (size_t)n) { otaJobFail(j, j.flash->errorString()); return; }
+  j.written += n;
+  if (j.written < j.total) return;
+
+  // Whole image flashed: verify before it can ever be booted
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&j.sha, digest);
+  mbedtls_sha256_free(&j.sha);
+  j.in = nullptr;
+  if (memcmp(digest, j.expected, 32) != 0) { j.flash->abort(); otaSetError(j, "SHA-256 mismatch"); j.state = OTA_FAILED; return; }
+  if (!j.flash->end()) { otaSetError(j, j.flash->errorString()); j.state = OTA_FAILED; return; }
+  j.state = OTA_DONE;
+}
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef PLAY_QUEUE_H
+#define PLAY_QUEUE_H
+
+#include "Arduino.h"
+
+// ================= PLAYBACK QUEUE =================
+// One buzzer shared by bells, alarms, Telegram/dashboard music and piano
+// tones. Pure logic on the millis() passed in; the sketch drives the LEDC
+// through a PlayOutput, tests/ runs it on a virtual clock.
+#define PLAY_QUEUE_SIZE 8
+enum PlayPrio { PRIO_MUSIC = 0, PRIO_BELL, PRIO_ALARM }; // Higher preempts lower
+const float PLAY_NOTE_GAP = 1.30; // Note period / sounding time
+
+class PlayOutput {
+public:
+  virtual ~PlayOutput() {}
+  virtual void tone(int freq) = 0;                       // 0 = silent
+  virtual int songCount() = 0;
+  virtual int songLength(int song) = 0;                  // Notes
+  virtual int songNote(int song, int i, int &tempo) = 0; // Freq, 0 = rest
+};
+
+struct PlayItem {
+  int16_t song;       // SONGS index, -1 = plain tone
+  uint16_t freq;      // Tone only
+  uint16_t tone_ms;   // Tone only
+  uint16_t resume;    // Note to restart from (preempted music)
+  uint8_t prio;       // PlayPrio
+};
+
+struct Player {
+  PlayOutput* out;
+  PlayItem queue[PLAY_QUEUE_SIZE]; // Sorted by priority, FIFO within a priority
+  int queue_len;
+  PlayItem now;                    // Valid while playing
+  bool playing;
+  int note_index;
+  unsigned long note_start;
+  bool note_on;
+};
+
+inline void playStart(Player &p, const PlayItem &it, unsigned long now) {
+  p.now = it;
+  p.playing = true;
+  p.note_on = false;
+  p.note_start = now;
+  if (it.song >= 0) p.note_index = it.resume;
+  else p.out->tone(it.freq);
+}
+
+inline void playNext(Player &p, unsigned long now) {
+  p.out->tone(0);
+  if (p.queue_len == 0) { p.playing = false; return; }
+  PlayItem it = p.queue[0];
+  p.queue_len--;
+  memmove(p.queue, p.queue + 1, p.queue_len * sizeof(PlayItem));
+  playStart(p, it, now);
+}
+
+inline bool playEnqueue(Player &p, const PlayItem &it) {
+  // Same alarm/bell already waiting: don't stack repeats
+  for (int i = 0; i < p.queue_len; i++) {
+    if (it.prio > PRIO_MUSIC && p.queue[i].song == it.song) return false;
+  }
+  if (p.queue_len == PLAY_QUEUE_SIZE) {
+    if (p.queue[PLAY_QUEUE_SIZE - 1].prio >= it.prio) return false;
+    p.queue_len--; // Evict the lowest-priority tail
+  }
+  int pos = p.queue_len;
+  while (pos > 0 && p.queue[pos - 1].prio < it.prio) {
+    p.queue[pos] = p.queue[pos - 1];
+    pos--;
+  }
+  p.queue[pos] = it;
+  p.queue_len++;
+  return true;
+}
+
+// User "stop": clears music and tones, bells and alarms carry on
+inline void playStopMusic(Player &p, unsigned long now) {
+  int j = 0;
+  for (int i = 0; i < p.queue_len; i++) {
+    if (p.queue[i].prio > PRIO_MUSIC) p.queue[j++] = p.queue[i];
+  }
+  p.queue_len = j;
+  if (p.playing && p.now.prio == PRIO_MUSIC) playNext(p, now);
+}
+
+// Rules: higher priority preempts (music is resumed afterwards), a new music
+// request or piano tone replaces music, anything else waits its turn.
+inline void playRequest(Player &p, const PlayItem &it, unsigned long now) {
+  if (!p.playing) { playStart(p, it, now); return; }
+
+  if (it.prio > p.now.prio) {
+    if (p.now.song >= 0) {
+      PlayItem back = p.now;
+      back.resume = p.note_index;
+      playEnqueue(p, back);
+    }
+    playStart(p, it, now);
+  } else if (it.prio == PRIO_MUSIC && p.now.prio == PRIO_MUSIC) {
+    if (it.song >= 0) {
+      playStopMusic(p, now); // New song: forget anything paused
+    } else if (p.now.song >= 0) {
+      PlayItem back = p.now; // Piano over a song: song continues after
+      back.resume = p.note_index;
+      playEnqueue(p, back);
+    }
+    playStart(p, it, now);
+  } else if (it.song >= 0) {
+    playEnqueue(p, it); // Piano tones are dropped while a bell/alarm plays
+  }
+}
+
+// False for an unknown song id
+inline bool playSong(Player &p, int song, uint8_t prio, unsigned long now) {
+  if (song < 0 || song >= p.out->songCount()) return false;
+  PlayItem it = { (int16_t)song, 0, 0, 0, prio };
+  playRequest(p, it, now);
+  return true;
+}
+
+// Non-blocking: queued like a song, ended by playTick()
+inline void playTone(Player &p, int freq, int duration, unsigned long now) {
+  PlayItem it = { -1, (uint16_t)freq, (uint16_t)duration, 0, PRIO_MUSIC };
+  playRequest(p, it, now);
+}
+
+// Call every loop(): advances notes, ends tones, starts what's queued next
+inline void playTick(Player &p, unsigned long now) {
+  if (!p.playing) return;
+
+  if (p.now.song < 0) {
+    if (now - p.note_start >= p.now.tone_ms) playNext(p, now);
+    return;
+  }
+
+  int tempo;
+  int freq = p.out->songNote(p.now.song, p.note_index, tempo);
+  unsigned long duration = 1000 / tempo;
+  unsigned long period = duration * PLAY_NOTE_GAP;
+
+  if (!p.note_on) { // First note after playStart()
+    p.out->tone(freq);
+    p.note_on = true;
+  } else {
+    if (now - p.note_start >= duration) p.out->tone(0);
+    if (now - p.note_start >= period) {
+      p.note_on = false;
+      // Next note on the beat, not one loop() late; after a long stall
+      // (TLS handshake) pick up from now instead of rushing to catch up
+      p.note_start = (now - p.note_start < 2 * period) ? p.note_start + period : now;
+      p.note_index++;
+      if (p.note_index >= p.out->songLength(p.now.song)) {
+        p.note_index = 0;
+        playNext(p, now); // Stop after one loop for bells/songs
+      } else {
+        p.out->tone(p.out->songNote(p.now.song, p.note_index, tempo));
+        p.note_on = true;
+      }
+    }
+  }
+}
+
+#endif
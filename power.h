@@ -0,0 +1,102 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include "Arduino.h"
+
+// ================= POWER MANAGER =================
+// Decisions only: when the next loop() timer is due, which state to be in,
+// whether the sound wake may be armed. The sketch does the sleeping and
+// clock switching; tests/ replays the room traces against a virtual clock.
+// Awake states keep WiFi in modem sleep. Light sleep does not keep the
+// association (ESP-IDF), so the sketch takes WiFi down around it and pays a
+// rejoin plus a TLS handshake afterwards; only long windows are worth that.
+const unsigned long POWER_HTTP_GRACE_MS = 30000;  // Stay awake after a dashboard hit
+const unsigned long POWER_MIN_SLEEP_MS  = 8000;   // Rejoin + TLS cost more below (tests/test_power.cpp)
+const unsigned long POWER_MAX_SLEEP_MS  = 60000;  // Wake at least once a minute
+const unsigned long POWER_WAKE_CONFIRM_MS = 60000; // Sound wake must lead to "busy" within this
+const unsigned long POWER_BACKOFF_MIN_MS  = 60000; // Hold-off after a spurious wake, doubling
+const unsigned long POWER_BACKOFF_MAX_MS  = 1800000;
+const uint32_t CPU_MHZ_ACTIVE = 240;
+const uint32_t CPU_MHZ_IDLE   = 80;               // Lowest that keeps WiFi up
+
+enum PowerState { POWER_ACTIVE = 0, POWER_IDLE, POWER_SLEEP, POWER_STATES };
+
+// Time per state, for /metrics
+struct PowerMeter {
+  PowerState state;
+  int64_t since_us;
+  uint64_t time_us[POWER_STATES];
+  uint32_t sleeps;
+  uint32_t sound_wakes;
+  uint32_t spurious_wakes;
+};
+
+// Sound wake arming with back-off: a wake that doesn't lead to "busy" within
+// POWER_WAKE_CONFIRM_MS (a truck passing an empty room) doubles the hold-off
+struct SoundWake {
+  bool pending;              // Woke on sound, verdict not in yet
+  unsigned long pending_since;
+  unsigned long hold_since;  // No arming for hold_ms after this
+  unsigned long hold_ms;
+  uint8_t spurious;          // Consecutive spurious wakes
+};
+
+// Books the time since the last call to the current state; true on a change
+inline bool powerAccount(PowerMeter &m, PowerState st, int64_t now_us) {
+  m.time_us[m.state] += now_us - m.since_us;
+  m.since_us = now_us;
+  if (st == m.state) return false;
+  m.state = st;
+  return true;
+}
+
+// Milliseconds until the earliest due time, 0 if one is due, at most max_ms
+inline unsigned long powerWait(const unsigned long *due, int n, unsigned long now, unsigned long max_ms) {
+  unsigned long wait = max_ms;
+  for (int i = 0; i < n; i++) {
+    long left = (long)(due[i] - now);
+    if (left <= 0) return 0;
+    if ((unsigned long)left < wait) wait = left;
+  }
+  return wait;
+}
+
+// Busy = full clock. Daytime, a short gap, or WiFi still rejoining (or
+// gone: stay reachable on the AP fallback) = low clock with modem sleep.
+// Empty at night with a long gap before the next timer = light sleep.
+inline PowerState powerDecide(bool busy, bool day, bool wifi_up, unsigned long wait) {
+  if (busy) return POWER_ACTIVE;
+  if (day || !wifi_up || wait < POWER_MIN_SLEEP_MS) return POWER_IDLE;
+  return POWER_SLEEP;
+}
+
+// pin_low: the sound pin, read as a digital input, is LOW right now.
+// Arming a level wake on a pin that is already HIGH would return at once.
+inline bool soundWakeArm(const SoundWake &sw, bool sensor_ok, bool pin_low, unsigned long now) {
+  if (!sensor_ok || !pin_low || sw.pending) return false;
+  return now - sw.hold_since >= sw.hold_ms;
+}
+
+inline void soundWakeFired(SoundWake &sw, unsigned long now) {
+  sw.pending = true;
+  sw.pending_since = now;
+}
+
+// Call every loop(); resolves a pending wake. Returns true on a spurious one.
+inline bool soundWakeUpdate(SoundWake &sw, bool busy, unsigned long now) {
+  if (!sw.pending) return false;
+  if (busy) {
+    sw.pending = false;
+    sw.spurious = 0;
+    sw.hold_ms = 0;
+    return false;
+  }
+  if (now - sw.pending_since < POWER_WAKE_CONFIRM_MS) return false;
+  sw.pending = false;
+  if (sw.spurious < 16) sw.spurious++;
+  sw.hold_since = now;
+  sw.hold_ms = min(POWER_BACKOFF_MIN_MS << min((int)sw.spurious - 1, 5), POWER_BACKOFF_MAX_MS);
+  return true;
+}
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef REPLY_WRITER_H
+#define REPLY_WRITER_H
+
+#include "Arduino.h"
+
+// ================= STREAM WRITER =================
+// A Print that fills one shared scratch buffer and hands it to a sink when
+// full. Replies never overlap, so the sketch owns a single reply_buf.
+#define REPLY_BUF_SIZE  512   // Shared scratch, flushed to the sink when full
+#define REPLY_FMT_MAX   128   // Longest single printf_P expansion
+
+extern char reply_buf[REPLY_BUF_SIZE];
+
+// Content sink: called with each full buffer, then once with len == 0 at end()
+typedef void (*ReplySink)(const char* data, size_t len);
+
+class ReplyWriter : public Print {
+public:
+  // Sink does its own framing (e.g. server.sendContent)
+  explicit ReplyWriter(ReplySink sink)
+    : sink_(sink), out_(nullptr), len_(0), total_(0), escape_(false) {}
+  // Raw Print (TLS client), HTTP/1.1 chunk framing done here
+  explicit ReplyWriter(Print* out)
+    : sink_(nullptr), out_(out), len_(0), total_(0), escape_(false) {}
+
+  size_t write(uint8_t c) {
+    if (!escape_) { put(c); return 1; }
+    switch (c) {
+      case '"':  put('\\'); put('"'); break;
+      case '\\': put('\\'); put('\\'); break;
+      case '\n': put('\\'); put('n'); break;
+      case '\r': put('\\'); put('r'); break;
+      case '\t': put('\\'); put('t'); break;
+      default:
+        if (c < 0x20) {
+          static const char hex[] = "0123456789abcdef";
+          put('\\'); put('u'); put('0'); put('0');
+          put(hex[c >> 4]); put(hex[c & 0xF]);
+        } else {
+          put(c); // UTF-8 continuation bytes pass through
+        }
+    }
+    return 1;
+  }
+
+  size_t write(const uint8_t* b, size_t n) {
+    for (size_t i = 0; i < n; i++) write(b[i]);
+    return n;
+  }
+
+  // Formats on the stack instead of Print::printf, which mallocs past 64 chars.
+  size_t printf_P(PGM_P fmt, ...) {
+    char tmp[REPLY_FMT_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf_P(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    if (n >= (int)sizeof(tmp)) n = sizeof(tmp) - 1; // Truncate
+    return write((const uint8_t*)tmp, n);
+  }
+
+  void setEscape(bool on) { escape_ = on; } // JSON string escaping
+
+  void flush() {
+    if (len_ == 0) return;
+    if (sink_) {
+      sink_(reply_buf, len_);
+    } else if (out_) {
+      char head[12];
+      int h = snprintf(head, sizeof(head), "%X\r\n", (unsigned)len_);
+      out_->write((const uint8_t*)head, h);
+      out_->write((const uint8_t*)reply_buf, len_);
+      out_->write((const uint8_t*)"\r\n", 2);
+    }
+    len_ = 0;
+  }
+
+  void end() {
+    flush();
+    if (sink_) sink_(reply_buf, 0);
+    else if (out_) out_->write((const uint8_t*)"0\r\n\r\n", 5);
+  }
+
+  size_t total() const { return total_; }
+
+private:
+  void put(char c) {
+    if (len_ == REPLY_BUF_SIZE) flush();
+    reply_buf[len_++] = c;
+    total_++;
+  }
+
+  ReplySink sink_;
+  Print* out_;
+  size_t len_;
+  size_t total_;
+  bool escape_;
+};
+
+#endif
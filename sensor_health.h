@@ -0,0 +1,100 @@
+#ifndef SENSOR_HEALTH_H
+#define SENSOR_HEALTH_H
+
+#include "Arduino.h"
+
+// ================= SENSOR HEALTH =================
+// Per-channel fault detectors in constant memory. Pure logic: the sketch
+// feeds readings and sends the maintenance alerts, tests/ replays traces.
+enum SensorFault { FAULT_NONE = 0, FAULT_NAN, FAULT_STUCK, FAULT_RAIL, FAULT_NOISY };
+
+struct ChannelSpec {
+  const char* name;        // JSON key of the reading
+  float rail_lo, rail_hi;  // At/beyond = saturated or shorted
+  uint16_t stuck_ticks;    // Identical off-rail readings before "stuck" (0 = off)
+  float noise_sd;          // Tick-to-tick SD above this = floating pin (0 = off)
+  float noise_gate;        // Steps from/to a reading at or below this count as 0
+};
+
+const uint8_t SENSOR_NAN_LIMIT    = 3;    // Consecutive failed DHT reads
+const uint8_t SENSOR_RAIL_LIMIT   = 5;    // Consecutive readings on a rail
+const uint8_t SENSOR_WARMUP       = 30;   // Readings before any fault is raised
+const uint8_t SENSOR_CLEAR_TICKS  = 10;   // Clean readings before a fault clears
+const float SENSOR_NOISE_ALPHA    = 0.05; // EMA of the squared first difference
+const float SENSOR_NOISE_CLIP     = 2;    // Per-tick difference capped at this many noise_sd
+
+struct ChannelHealth {
+  float last;              // Previous reading (seeded by the first one)
+  float diff_var;          // EMA of clipped (v - last)^2: one step can't trip it, chatter does
+  uint16_t samples;        // Readings seen, saturates after warm-up
+  uint16_t nan_streak, stuck_streak, rail_streak, clean_streak;
+  uint8_t fault;           // SensorFault
+  bool seeded;
+};
+
+// Feeds one reading; returns true when hs.fault changed.
+inline bool sensorUpdate(ChannelHealth &hs, const ChannelSpec &sp, float v) {
+  uint8_t cand = FAULT_NONE;
+  if (hs.samples < SENSOR_WARMUP) hs.samples++;
+
+  if (isnan(v)) {
+    if (hs.nan_streak < 0xFFFF) hs.nan_streak++;
+    if (hs.nan_streak >= SENSOR_NAN_LIMIT) cand = FAULT_NAN;
+    else cand = hs.fault; // Too early to tell, keep previous verdict
+  } else {
+    hs.nan_streak = 0;
+    bool on_rail = (v <= sp.rail_lo || v >= sp.rail_hi);
+
+    if (!hs.seeded) {
+      hs.last = v; // Seed: the first difference must not look like noise
+      hs.seeded = true;
+    }
+    // Clipped so a light switch or a jump to the rail adds at most
+    // ALPHA * CLIP^2 = 0.2 of the limit; only sustained chatter reaches it.
+    // Gated so a quiet floor (silent room, a click now and then) only decays it.
+    float d = v - hs.last;
+    float clip = SENSOR_NOISE_CLIP * sp.noise_sd;
+    bool gated = (v <= sp.noise_gate || hs.last <= sp.noise_gate);
+    float d2 = gated ? 0 : min(d * d, clip * clip);
+    hs.diff_var += SENSOR_NOISE_ALPHA * (d2 - hs.diff_var);
+
+    if (on_rail) { if (hs.rail_streak < 0xFFFF) hs.rail_streak++; }
+    else hs.rail_streak = 0;
+    // A rail reading is the rail detector's business, not a stuck ADC
+    if (!on_rail && v == hs.last) { if (hs.stuck_streak < 0xFFFF) hs.stuck_streak++; }
+    else hs.stuck_streak = 0;
+    hs.last = v;
+
+    if (hs.rail_streak >= SENSOR_RAIL_LIMIT) cand = FAULT_RAIL;
+    else if (sp.stuck_ticks && hs.stuck_streak >= sp.stuck_ticks) cand = FAULT_STUCK;
+    else if (sp.noise_sd > 0) {
+      // Clear only once the SD has halved
+      float limit = (hs.fault == FAULT_NOISY) ? sp.noise_sd * 0.5 : sp.noise_sd;
+      if (hs.diff_var > limit * limit) cand = FAULT_NOISY;
+    }
+  }
+  if (hs.samples < SENSOR_WARMUP) cand = FAULT_NONE; // MQ heaters, first DHT reads
+
+  // Faults latch until SENSOR_CLEAR_TICKS clean readings in a row
+  if (cand == FAULT_NONE && hs.fault != FAULT_NONE) {
+    if (hs.clean_streak < 0xFFFF) hs.clean_streak++;
+    if (hs.clean_streak < SENSOR_CLEAR_TICKS) return false;
+  } else {
+    hs.clean_streak = 0;
+  }
+  if (cand == hs.fault) return false;
+  hs.fault = cand;
+  return true;
+}
+
+inline const char* sensorFaultName(uint8_t f) {
+  switch (f) {
+    case FAULT_NAN:   return "no data";
+    case FAULT_STUCK: return "stuck";
+    case FAULT_RAIL:  return "saturated";
+    case FAULT_NOISY: return "floating";
+    default:          return "ok";
+  }
+}
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Minimal Arduino surface for building the sketch's logic headers with g++.
+// Only what those headers use; hardware calls stay in SmartClass_IoT.ino.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <math.h>
+#include <string>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+#define PROGMEM
+#define PGM_P             const char*
+#define PSTR(s)           (s)
+#define F(s)              (s)
+#define pgm_read_word(p)  (*(p))
+#define pgm_read_byte(p)  (*(const uint8_t*)(p))
+#define vsnprintf_P       vsnprintf
+#define snprintf_P        snprintf
+
+#define constrain(x, lo, hi) ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* b, size_t n) {
+    for (size_t i = 0; i < n; i++) write(b[i]);
+    return n;
+  }
+  virtual void flush() {}
+  size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return printf("%d", v); }
+  size_t print(unsigned v) { return printf("%u", v); }
+  size_t print(long v) { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t print(double v, int d = 2) { return printf("%.*f", d, v); }
+  // Like the ESP32 core: stack buffer up to 64 chars, heap beyond that
+  size_t printf(const char* fmt, ...) {
+    char loc[64];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(loc, sizeof(loc), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    if (n < (int)sizeof(loc)) return write((const uint8_t*)loc, n);
+    char* big = (char*)malloc(n + 1);
+    va_start(ap, fmt);
+    vsnprintf(big, n + 1, fmt, ap);
+    va_end(ap);
+    size_t r = write((const uint8_t*)big, n);
+    free(big);
+    return r;
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual size_t readBytes(char* b, size_t n) {
+    size_t got = 0;
+    while (got < n) {
+      int c = read();
+      if (c < 0) break;
+      b[got++] = (char)c;
+    }
+    return got;
+  }
+  size_t readBytes(uint8_t* b, size_t n) { return readBytes((char*)b, n); }
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef HOST_CHECK_H
+#define HOST_CHECK_H
+
+#include <stdio.h>
+
+// Tiny assertion helpers: every failed CHECK is reported, main() returns
+// checkResult() so make stops on the first failing test binary.
+static int check_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); check_failures++; } \
+  } while (0)
+
+#define CHECK_NEAR(a, b, tol) do { \
+    double _a = (a), _b = (b); \
+    if (fabs(_a - _b) > (tol)) { \
+      fprintf(stderr, "%s:%d: CHECK_NEAR failed: %s = %g, %s = %g (tol %g)\n", \
+              __FILE__, __LINE__, #a, _a, #b, _b, (double)(tol)); \
+      check_failures++; \
+    } \
+  } while (0)
+
+static inline int checkResult(const char* name) {
+  if (check_failures) { fprintf(stderr, "%s: %d check(s) failed\n", name, check_failures); return 1; }
+  printf("%s: OK\n", name);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef HOST_MBEDTLS_SHA256_H
+#define HOST_MBEDTLS_SHA256_H
+
+// mbedtls SHA-256 API on top of OpenSSL (link with -lcrypto)
+#include <openssl/sha.h>
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+typedef SHA256_CTX mbedtls_sha256_context;
+static inline void mbedtls_sha256_init(mbedtls_sha256_context*) {}
+static inline void mbedtls_sha256_free(mbedtls_sha256_context*) {}
+static inline int mbedtls_sha256_starts(mbedtls_sha256_context* c, int) { return !SHA256_Init(c); }
+static inline int mbedtls_sha256_update(mbedtls_sha256_context* c, const unsigned char* d, size_t n) { return !SHA256_Update(c, d, n); }
+static inline int mbedtls_sha256_finish(mbedtls_sha256_context* c, unsigned char out[32]) { return !SHA256_Final(out, c); }
+#pragma GCC diagnostic pop
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef HOST_TRACES_H
+#define HOST_TRACES_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Labeled room traces in traces/: one row per second,
+// sec,dist,db,lux,label with label 1 = occupied. Lines starting with #
+// and the header are skipped.
+#ifndef TRACE_DIR
+#define TRACE_DIR "traces/"
+#endif
+
+struct Sample { float dist, db, lux; int label; };
+
+static std::vector<Sample> loadTrace(const char* name) {
+  std::vector<Sample> out;
+  std::string path = std::string(TRACE_DIR) + name;
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f) { fprintf(stderr, "cannot open %s\n", path.c_str()); return out; }
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    Sample s;
+    int sec;
+    if (sscanf(line, "%d,%f,%f,%f,%d", &sec, &s.dist, &s.db, &s.lux, &s.label) == 5) out.push_back(s);
+  }
+  fclose(f);
+  return out;
+}
+
+#endif
@@ -0,0 +1,97 @@
+// Compares the histogram percentiles against exact (sorted) percentiles on
+// large synthetic traces, and checks the range/exceedance counters.
+#include "Arduino.h"
+#include "compliance.h"
+#include "check.h"
+#include <random>
+#include <vector>
+#include <functional>
+
+// Same x10 layout as STAT_SPEC in the sketch
+const MetricSpec TEMP  = {"Suhu",   "C",   180, 300,   10};
+const MetricSpec HUMID = {"Lembab", "%",   400, 600,   20};
+const MetricSpec NOISE = {"Suara",  "dB",  0,   550,   20};
+const MetricSpec CO2   = {"Udara",  "PPM", 0,   10000, 640};
+
+// Nearest-rank percentile, the definition statPercentile() approximates
+static int32_t exactPercentile(std::vector<int32_t> v, int pct) {
+  size_t rank = ((uint64_t)pct * v.size() + 99) / 100;
+  std::nth_element(v.begin(), v.begin() + (rank - 1), v.end());
+  return v[rank - 1];
+}
+
+static void checkTrace(const char* name, const MetricSpec& sp, size_t n, std::function<double()> gen) {
+  MetricStats st = {};
+  std::vector<int32_t> vals;
+  vals.reserve(n);
+  for (size_t i = 0; i < n; i++) {
+    int32_t v10 = (int32_t)lround(gen() * 10);
+    v10 = constrain(v10, 0, STAT_BUCKETS * sp.bucket_w - 1); // Sensors stay inside the histogram
+    vals.push_back(v10);
+    statAdd(st, sp, v10);
+  }
+  CHECK(st.samples == n);
+  printf("  %-14s n=%zu", name, n);
+  const int pcts[] = {5, 50, 95, 99};
+  for (int pct : pcts) {
+    int32_t est = statPercentile(st, sp, pct), ex = exactPercentile(vals, pct);
+    printf("  P%d %.1f/%.1f", pct, est / 10.0, ex / 10.0);
+    CHECK(abs(est - ex) <= sp.bucket_w);
+  }
+  printf("  (est/exact, bucket %.1f)\n", sp.bucket_w / 10.0);
+}
+
+static void testCounters() {
+  MetricStats st = {};
+  // 10 s in range, 5 s over, 3 s in range, 20 s over
+  for (int i = 0; i < 10; i++) statAdd(st, TEMP, 250);
+  for (int i = 0; i < 5; i++)  statAdd(st, TEMP, 320);
+  for (int i = 0; i < 3; i++)  statAdd(st, TEMP, 300); // hi is inclusive
+  for (int i = 0; i < 20; i++) statAdd(st, TEMP, 150);
+  CHECK(st.samples == 38);
+  CHECK(st.in_range == 13);
+  CHECK(st.exceed_count == 2);
+  CHECK(st.exceed_max == 20);
+  CHECK(st.exceed_cur == 20);
+  // Out-of-histogram values land in the edge buckets
+  MetricStats e = {};
+  statAdd(e, TEMP, -50);
+  statAdd(e, TEMP, 9999);
+  CHECK(e.hist[0] == 1 && e.hist[STAT_BUCKETS - 1] == 1);
+  CHECK(statPercentile(MetricStats{}, TEMP, 50) == 0);
+}
+
+static void testLongDay() {
+  // A full day on one value: 86400 samples in one bucket must not saturate
+  MetricStats st = {};
+  for (int i = 0; i < 86400; i++) statAdd(st, CO2, i < 70000 ? 4500 : 15000);
+  CHECK(st.hist[4500 / CO2.bucket_w] == 70000);
+  CHECK_NEAR(statPercentile(st, CO2, 50), 4500, CO2.bucket_w);
+  CHECK_NEAR(statPercentile(st, CO2, 95), 15000, CO2.bucket_w);
+}
+
+int main() {
+  testCounters();
+  testLongDay();
+
+  std::mt19937 rng(2024);
+  std::normal_distribution<double> temp(27.5, 1.8);
+  std::uniform_real_distribution<double> u(0, 1);
+  std::normal_distribution<double> hum_dry(52, 4), hum_wet(78, 5);
+  std::lognormal_distribution<double> noise(log(48.0), 0.18);
+  printf("percentiles on synthetic traces:\n");
+  checkTrace("temperature", TEMP, 1000000, [&] { return temp(rng); });
+  checkTrace("humidity", HUMID, 1000000, [&] { return u(rng) < 0.6 ? hum_dry(rng) : hum_wet(rng); });
+  checkTrace("noise", NOISE, 1000000, [&] { return noise(rng); });
+  // CO2: 45-minute lessons ramping 450 -> ~2200 ppm, flushed in the breaks
+  size_t sec = 0;
+  checkTrace("co2", CO2, 1000000, [&] {
+    double phase = (sec++ % 3600) / 60.0;
+    double ppm = phase < 45 ? 450 + 39 * phase : 2205 - 150 * (phase - 45);
+    return fmax(ppm, 450.0) + 20 * (u(rng) - 0.5);
+  });
+  // Spike-heavy tail: rare very loud events must still show in P99
+  checkTrace("noise spikes", NOISE, 1000000, [&] { return u(rng) < 0.03 ? 95 + 10 * u(rng) : noise(rng); });
+
+  return checkResult("test_compliance");
+}
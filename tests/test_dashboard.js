@@ -0,0 +1,133 @@
+// Dashboard script from index.h under node, no browser: a Proxy DOM counts
+// innerText/className writes and canvas draws, fetch is mocked. Checks the
+// diffing renderer, the sparkline ring, the history seed, and the gzip
+// budget of the PROGMEM page.
+// Run from tests/ with: node test_dashboard.js
+'use strict';
+const fs = require('fs');
+const zlib = require('zlib');
+const path = require('path');
+
+let failures = 0;
+function check(cond, what) {
+  if (!cond) { console.error('test_dashboard.js: CHECK failed: ' + what); failures++; }
+}
+
+// ---- The page as served: HTML_HEAD + HTML_BODY ----
+const src = fs.readFileSync(path.join(__dirname, '..', 'index.h'), 'utf8');
+const page = [...src.matchAll(/R"=====\(([\s\S]*?)\)====="/g)].map(m => m[1]).join('');
+const script = page.slice(page.lastIndexOf('<script>') + 8, page.lastIndexOf('</script>'));
+
+const PAGE_GZ_BUDGET = 6656, SCRIPT_GZ_BUDGET = 2048;
+const page_gz = zlib.gzipSync(page, { level: 9 }).length;
+const script_gz = zlib.gzipSync(script, { level: 9 }).length;
+console.log(`  page ${page.length} B (${page_gz} B gzip), script ${script.length} B (${script_gz} B gzip)`);
+check(page_gz <= PAGE_GZ_BUDGET, `page gzip ${page_gz} <= ${PAGE_GZ_BUDGET}`);
+check(script_gz <= SCRIPT_GZ_BUDGET, `script gzip ${script_gz} <= ${SCRIPT_GZ_BUDGET}`);
+
+// ---- Mock DOM ----
+let writes = 0, strokes = 0;
+const written = {};
+const els = {};
+const ctx = { clearRect() {}, beginPath() {}, moveTo() {}, lineTo() {}, stroke() { strokes++; } };
+function element(id) {
+  return new Proxy({ id, width: 120, height: 28, style: {}, getContext: () => ctx }, {
+    set(o, k, v) {
+      if (k === 'innerText' || k === 'className') { writes++; written[id + '.' + k] = v; }
+      o[k] = v;
+      return true;
+    }
+  });
+}
+const document = { getElementById: id => els[id] || (els[id] = element(id)) };
+const window = { location: { hostname: '192.168.1.50' } };
+
+let data, history;
+const fetched = [];
+function fetch(url) {
+  fetched.push(url);
+  const body = url.startsWith('/api/v2/history') ? history : url.startsWith('/data') ? data : {};
+  return Promise.resolve({ json: () => Promise.resolve(JSON.parse(JSON.stringify(body))) });
+}
+let intervals = 0;
+function setInterval() { intervals++; }
+const settle = () => new Promise(r => setImmediate(r));
+
+const TS = 1760000000 - 1760000000 % 600;
+data = { t: 25.1, h: 50, gas: 400, db: 40, mq2: 100, time: '07:00', ai: true, fan: false,
+         lamp: true, bell: true, health: 'OK', ts: TS + 7200 };
+// Deliberately not in KEYS order, with an extra column: the seed must map
+// columns by name
+history = {
+  from: TS - 86400, to: TS + 7200, step: 600,
+  fields: ['ts', 'db', 'mq2', 't', 'gas', 'h'],
+  rows: [[TS, 38.5, 120, 24, 380, 49], [TS + 600, null, 121, 24.5, 390, 50], [TS + 1200, 41, 119, null, 395, 51]]
+};
+
+const T = new Function('document', 'window', 'fetch', 'setInterval',
+  script + '\nreturn { update, R, push, N };')(document, window, fetch, setInterval);
+
+(async () => {
+  await settle(); await settle(); await settle(); await settle();
+
+  // Seed: one history request, then live polling
+  check(fetched[0] === '/api/v2/history?step=600&fields=t,h,gas,db', 'history URL ' + fetched[0]);
+  check(intervals === 1, 'polling started once');
+  const ring = k => { const r = T.R[k]; return Array.from({ length: T.N }, (_, i) => r.v[(r.head + 1 + i) % T.N]); };
+  const seeded = k => ring(k).filter(v => v != null);
+  check(JSON.stringify(seeded('db').slice(0, 2)) === '[38.5,41]', 'db seeded from its own column: ' + seeded('db'));
+  check(JSON.stringify(seeded('t').slice(0, 2)) === '[24,24.5]', 't seeded from its own column: ' + seeded('t'));
+  check(JSON.stringify(seeded('gas').slice(0, 3)) === '[380,390,395]', 'gas seeded: ' + seeded('gas'));
+  check(!seeded('db').includes(120) && !seeded('h').includes(390), 'no column shifted into another key');
+
+  // First poll writes every bound node once
+  await settle();
+  const first = writes;
+  check(written['t.innerText'] === '25.1' && written['ai_status.className'] === 'badge ok', 'first render');
+  console.log(`  first render: ${first} writes`);
+
+  // Identical data: zero DOM writes
+  let w0 = writes;
+  for (let i = 0; i < 10; i++) { T.update(); await settle(); }
+  console.log(`  10 unchanged polls: ${writes - w0} writes`);
+  check(writes === w0, 'unchanged polls write nothing');
+
+  // One value changes: exactly one write
+  data.t = 26.04;
+  w0 = writes; T.update(); await settle();
+  check(writes - w0 === 1 && written['t.innerText'] === '26.0', 'one change, one write');
+  // Change below display resolution: no write
+  data.t = 25.98;
+  w0 = writes; T.update(); await settle();
+  check(writes === w0, 'same rounded text, no write');
+  // Smoke: text and class of one badge
+  data.mq2 = 2500;
+  w0 = writes; T.update(); await settle();
+  check(writes - w0 === 2 && written['mq2_stat.className'] === 'badge err', 'smoke badge');
+  // Sensor fault: null renders as --
+  data.db = null;
+  T.update(); await settle();
+  check(written['db.innerText'] === '--', 'null reading shows --');
+
+  // Canvas only redrawn for series that changed: same bucket, db faulted
+  strokes = 0;
+  T.update(); await settle();
+  check(strokes === 3, 'db is null: 3 of 4 sparklines redrawn, got ' + strokes);
+  // Next bucket: every ring shifts, db included
+  strokes = 0;
+  data.ts += 600;
+  T.update(); await settle();
+  check(strokes === 4, 'new bucket redraws all 4, got ' + strokes);
+
+  // Sparkline ring: bounded, gaps padded with nulls, old samples ignored
+  const r = T.R.t;
+  T.push('t', TS + 86400 * 3, 30);
+  check(r.v.length === T.N, 'ring stays N long');
+  check(ring('t').filter(v => v != null).length === 1, 'a gap longer than the ring clears it');
+  const before = JSON.stringify(r.v);
+  T.push('t', TS, 10);
+  check(JSON.stringify(r.v) === before, 'samples older than the head are dropped');
+
+  if (failures) { console.error(`test_dashboard.js: ${failures} check(s) failed`); process.exit(1); }
+  console.log('test_dashboard.js: OK');
+})();
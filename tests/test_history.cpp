@@ -0,0 +1,187 @@
+// History store and /api/v2/history queries: interval means, ring wrap,
+// gaps and clock steps, field masks, step rounding, and the streamed JSON
+// checked against a naive filter-and-group reference. Then a load benchmark
+// over a full week of samples: histLowerBound and whole-range queries.
+#include "Arduino.h"
+#include "history.h"
+#include "check.h"
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+char reply_buf[REPLY_BUF_SIZE];
+
+const uint32_t T0 = 1760000400; // Interval-aligned Unix start
+
+static std::string body;
+static int chunks = 0;
+static void captureSink(const char* data, size_t len) {
+  if (len) { body.append(data, len); chunks++; }
+}
+
+static std::string query(const HistStore &hs, uint32_t from, uint32_t to, uint32_t step, uint8_t mask) {
+  body.clear();
+  chunks = 0;
+  ReplyWriter w(captureSink);
+  histQuery(hs, w, from, to, step, mask);
+  w.end();
+  return body;
+}
+
+// Same reply built the slow, obvious way from a copy of the samples
+static std::string reference(const std::vector<HistSample> &all, uint32_t from, uint32_t to, uint32_t step, uint8_t mask) {
+  char tmp[64];
+  std::string out;
+  snprintf(tmp, sizeof(tmp), "{\"from\":%u,\"to\":%u,\"step\":%u,\"fields\":[\"ts\"", from, to, step);
+  out += tmp;
+  for (int f = 0; f < HIST_FIELDS; f++) if (mask & (1 << f)) out += std::string(",\"") + HIST_FIELD[f].name + "\"";
+  out += "],\"rows\":[";
+  std::map<uint32_t, std::vector<const HistSample*>> groups;
+  for (const HistSample &s : all) if (s.ts >= from && s.ts <= to) groups[s.ts - s.ts % step].push_back(&s);
+  bool first = true;
+  for (auto &g : groups) {
+    snprintf(tmp, sizeof(tmp), "%s[%u", first ? "" : ",", g.first);
+    out += tmp;
+    for (int f = 0; f < HIST_FIELDS; f++) {
+      if (!(mask & (1 << f))) continue;
+      long sum = 0; int n = 0;
+      for (const HistSample *s : g.second) if (s->v[f] != HIST_NONE) { sum += s->v[f]; n++; }
+      if (n) { snprintf(tmp, sizeof(tmp), ",%.*f", HIST_FIELD[f].decimals, (float)sum / n / HIST_FIELD[f].scale); out += tmp; }
+      else out += ",null";
+    }
+    out += "]";
+    first = false;
+  }
+  return out + "]}";
+}
+
+static std::vector<HistSample> snapshot(const HistStore &hs) {
+  std::vector<HistSample> v;
+  for (int i = 0; i < hs.count; i++) v.push_back(histAt(hs, i));
+  return v;
+}
+
+// A classroom day: readings every 2 s, the device off overnight on weekends,
+// the DHT invalid for an afternoon. Returns the last wall time fed.
+static uint32_t fillDays(HistStore &hs, int days, std::mt19937 &rng) {
+  std::normal_distribution<float> n(0, 1);
+  uint32_t now = T0;
+  for (; now < T0 + days * 86400u; now += 2) {
+    uint32_t d = (now - T0) / 86400, sec = (now - T0) % 86400;
+    if (d % 7 == 5 && sec > 20 * 3600) continue;        // Power cut Saturday night
+    histRoll(hs, now);
+    float hour = sec / 3600.0f;
+    bool dht_ok = !(d == 2 && hour > 13 && hour < 16);
+    if (dht_ok) { histAdd(hs, 0, 26 + 3 * sin(hour / 24 * 2 * M_PI) + 0.2f * n(rng)); histAdd(hs, 1, 60 + n(rng)); }
+    histAdd(hs, 2, 300 + 40 * n(rng));
+    histAdd(hs, 3, 200 + 20 * n(rng));
+    histAdd(hs, 4, 45 + 5 * n(rng));
+    histAdd(hs, 5, (hour > 7 && hour < 15) ? 2600 : 300);
+    histAdd(hs, 6, (hour > 7 && hour < 15) ? 1 : 0);
+    histAdd(hs, 7, (hour > 11 && hour < 14) ? 2 : 0);
+  }
+  return now;
+}
+
+static void testBasics() {
+  static HistStore hs = {};
+  // Interval means, stamped with the interval start
+  for (uint32_t t = T0; t < T0 + 300; t++) { histRoll(hs, t); histAdd(hs, 0, t < T0 + 150 ? 20 : 22); histAdd(hs, 6, 1); }
+  CHECK(hs.count == 0);              // Not finished yet
+  histRoll(hs, T0 + 300);
+  CHECK(hs.count == 1 && histAt(hs, 0).ts == T0);
+  CHECK(histAt(hs, 0).v[0] == 210 && histAt(hs, 0).v[6] == 100);
+  CHECK(histAt(hs, 0).v[1] == HIST_NONE);
+  // Nothing valid in an interval: no sample at all
+  histRoll(hs, T0 + 600);
+  CHECK(hs.count == 1);
+  // Clock stepped backwards: the interval is dropped, order is kept
+  histRoll(hs, T0 - 3000);
+  histAdd(hs, 0, 25);
+  histRoll(hs, T0 - 2700);
+  CHECK(hs.count == 1);
+
+  CHECK(histLowerBound(hs, 0) == 0 && histLowerBound(hs, T0) == 0 && histLowerBound(hs, T0 + 1) == 1);
+
+  CHECK(histStep(0) == 300 && histStep(300) == 300 && histStep(301) == 600 && histStep(3600) == 3600);
+  CHECK(histStep(UINT32_MAX) == HIST_SIZE * HIST_INTERVAL_S); // No wrap to a tiny step
+
+  CHECK(histFieldMask("") == 0xFF && histFieldMask(nullptr) == 0xFF);
+  CHECK(histFieldMask("h") == (1 << 1));     // Not "mq2"
+  CHECK(histFieldMask("t,db,fan") == ((1 << 0) | (1 << 4) | (1 << 7)));
+  CHECK(histFieldMask("t,,lux,") == ((1 << 0) | (1 << 5)));
+  CHECK(histFieldMask("temp") == 0);
+
+  CHECK(query(hs, T0, T0 + 300, 300, 0x03) ==
+        "{\"from\":1760000400,\"to\":1760000700,\"step\":300,\"fields\":[\"ts\",\"t\",\"h\"],\"rows\":[[1760000400,21.0,null]]}");
+  CHECK(query(hs, T0 + 1, T0, 300, 0xFF).find("\"rows\":[]}") != std::string::npos);
+}
+
+static void testWeek(std::mt19937 &rng) {
+  static HistStore hs = {};
+  uint32_t end = fillDays(hs, 9, rng);  // Wraps: the first two days are gone
+  CHECK(hs.count == HIST_SIZE);
+  for (int i = 1; i < hs.count; i++) CHECK(histAt(hs, i).ts > histAt(hs, i - 1).ts);
+  std::vector<HistSample> all = snapshot(hs);
+  uint32_t oldest = all.front().ts, newest = all.back().ts;
+  CHECK(oldest > T0 + 86400);
+
+  struct Q { uint32_t from, to, step; uint8_t mask; };
+  const Q qs[] = {
+    {0, end, 300, 0xFF},                           // Everything
+    {end - 86400, end, 300, 0xFF},                 // Dashboard default
+    {end - 7 * 86400, end, 3600, 0x01},            // Week of temperature, hourly
+    {end - 7 * 86400, end, 86400, 0x30},           // Daily db/lux
+    {oldest + 17, newest - 17, 900, 0x83},         // Unaligned range
+    {T0 + 2 * 86400 + 12 * 3600, T0 + 2 * 86400 + 17 * 3600, 1800, 0x03}, // DHT gap -> nulls
+    {T0 + 5 * 86400 + 19 * 3600, T0 + 6 * 86400 + 2 * 3600, 3600, 0x40}, // Power cut -> rows missing
+    {0, oldest - 1, 300, 0xFF},                    // Before the store
+    {newest + 1, UINT32_MAX, 300, 0xFF},           // After it
+  };
+  int mismatches = 0;
+  for (const Q &q : qs) {
+    std::string got = query(hs, q.from, q.to, q.step, q.mask);
+    if (got != reference(all, q.from, q.to, q.step, q.mask)) {
+      fprintf(stderr, "  mismatch for from=%u to=%u step=%u mask=%02x\n", q.from, q.to, q.step, q.mask);
+      mismatches++;
+    }
+  }
+  CHECK(mismatches == 0);
+  CHECK(query(hs, T0 + 2 * 86400 + 12 * 3600, T0 + 2 * 86400 + 17 * 3600, 1800, 0x03).find("null") != std::string::npos);
+
+  // ---- Load benchmark ----
+  printf("  full store: %d samples, %zu bytes of RAM\n", hs.count, sizeof(HistStore));
+  std::uniform_int_distribution<uint32_t> ts(oldest - 3600, newest + 3600);
+  const int LB = 2000000;
+  int sink = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < LB; i++) sink += histLowerBound(hs, ts(rng));
+  double lb_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / LB;
+  printf("  histLowerBound: %.0f ns per lookup (%d)\n", lb_ns, sink & 1);
+
+  const Q bench[] = {
+    {0, end, 300, 0xFF},
+    {end - 86400, end, 300, 0xFF},
+    {end - 7 * 86400, end, 3600, 0x01},
+    {end - 3600, end, 300, 0xFF},
+  };
+  const char* names[] = {"week, 5 min, all fields", "day, 5 min, all fields", "week, hourly, t", "last hour, all fields"};
+  for (int k = 0; k < 4; k++) {
+    const Q &q = bench[k];
+    const int N = 200;
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; i++) query(hs, q.from, q.to, q.step, q.mask);
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / N;
+    printf("  %-26s %8.1f us, %6zu bytes in %3d chunks\n", names[k], us, body.size(), chunks);
+    CHECK((size_t)chunks == (body.size() + REPLY_BUF_SIZE - 1) / REPLY_BUF_SIZE); // Only full buffers leave
+  }
+}
+
+int main() {
+  std::mt19937 rng(7);
+  testBasics();
+  testWeek(rng);
+  return checkResult("test_history");
+}
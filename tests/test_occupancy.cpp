@@ -0,0 +1,119 @@
+// Replays the labeled traces in traces/ through occupancyUpdate() and scores
+// false positives / negatives against the ground truth, next to the old
+// single-tick rule the estimator replaced.
+#include "Arduino.h"
+#include "occupancy.h"
+#include "check.h"
+#include "traces.h"
+#include <vector>
+
+// Ticks after a label change that are not scored: the estimator needs a few
+// seconds of evidence, and a person leaving is not "empty" on the same tick.
+const int GRACE_S = 30;
+
+struct Score {
+  int scored, fp, fn;
+  int alarms;      // Empty -> Occupied edges while the room is empty
+  int detect_s;    // Seconds from first occupied label to first detection, -1 = never
+  float errRate() const { return scored ? (float)(fp + fn) / scored : 0; }
+};
+
+static bool oldRule(const Sample& s) {
+  return (s.dist > 0 && s.dist < 150) || s.db > 60;
+}
+
+template <typename Detector>
+static Score replay(const std::vector<Sample>& t, Detector detect) {
+  Score sc = {0, 0, 0, 0, -1};
+  int since_change = GRACE_S, first_occ = -1;
+  bool prev = false;
+  for (size_t i = 0; i < t.size(); i++) {
+    if (i > 0 && t[i].label != t[i - 1].label) since_change = 0;
+    else since_change++;
+    if (t[i].label && first_occ < 0) first_occ = i;
+
+    bool p = detect(t[i]);
+    if (p && !prev && !t[i].label && since_change >= GRACE_S) sc.alarms++;
+    if (p && first_occ >= 0 && sc.detect_s < 0) sc.detect_s = i - first_occ;
+    prev = p;
+
+    if (since_change < GRACE_S) continue;
+    sc.scored++;
+    if (p && !t[i].label) sc.fp++;
+    if (!p && t[i].label) sc.fn++;
+  }
+  return sc;
+}
+
+static Score runEstimator(const std::vector<Sample>& t) {
+  Occupancy o = {};
+  return replay(t, [&](const Sample& s) { return occupancyUpdate(o, s.dist, s.db, s.lux, true, true); });
+}
+
+static Score runOldRule(const std::vector<Sample>& t) {
+  return replay(t, oldRule);
+}
+
+static void report(const char* name, const Score& a, const Score& b) {
+  printf("  %-22s new: FP %4d FN %4d err %5.1f%% alarms %3d detect %4ds | old: FP %4d FN %4d err %5.1f%% alarms %3d\n",
+         name, a.fp, a.fn, 100 * a.errRate(), a.alarms, a.detect_s,
+         b.fp, b.fn, 100 * b.errRate(), b.alarms);
+}
+
+static void testRing() {
+  RingStat r = {};
+  for (int i = 0; i < OCC_WINDOW * 3; i++) ringPush(r, i % 2 ? 10 : 0);
+  CHECK(r.count == OCC_WINDOW);
+  CHECK_NEAR(ringMean(r), 5.0, 1e-3);
+  CHECK_NEAR(ringVar(r), 25.0, 1e-2);
+  // Constant input: variance must not go negative from float cancellation
+  for (int i = 0; i < OCC_WINDOW * 100; i++) ringPush(r, 1234.5);
+  CHECK(ringVar(r) >= 0);
+  CHECK_NEAR(ringMean(r), 1234.5, 1e-2);
+}
+
+static void testFaultyChannels() {
+  // With sound and light marked faulty, a loud but empty room stays empty
+  Occupancy o = {};
+  bool p = false;
+  for (int i = 0; i < 300; i++) p = occupancyUpdate(o, 320, 95, 0, false, false);
+  CHECK(!p);
+}
+
+int main() {
+  testRing();
+  testFaultyChannels();
+
+  const char* traces[] = {"class_day.csv", "quiet_exam.csv", "empty_traffic.csv",
+                          "empty_desk_echo.csv", "night_intruder.csv"};
+  Score n[5], o[5];
+  int n_err = 0, o_err = 0, scored = 0;
+  printf("occupancy traces (grace %d s after each label change):\n", GRACE_S);
+  for (int i = 0; i < 5; i++) {
+    std::vector<Sample> t = loadTrace(traces[i]);
+    CHECK(t.size() > 1000);
+    n[i] = runEstimator(t);
+    o[i] = runOldRule(t);
+    report(traces[i], n[i], o[i]);
+    n_err += n[i].fp + n[i].fn;
+    o_err += o[i].fp + o[i].fn;
+    scored += n[i].scored;
+  }
+  printf("  total error: new %.2f%%, old %.2f%%\n", 100.0 * n_err / scored, 100.0 * o_err / scored);
+
+  // Occupied rooms are recognised, quiet ones too, within the grace window
+  CHECK(n[0].detect_s >= 0 && n[0].detect_s <= GRACE_S);
+  CHECK(n[1].detect_s >= 0 && n[1].detect_s <= GRACE_S);
+  CHECK(n[0].errRate() < 0.02);
+  CHECK(n[1].errRate() < 0.02);
+  // Trucks and desk echoes must not raise the intruder alert
+  CHECK(n[2].alarms == 0 && n[2].fp == 0);
+  CHECK(n[3].alarms == 0 && n[3].fp == 0);
+  // A silent intruder in the dark is still caught
+  CHECK(n[4].detect_s >= 0 && n[4].detect_s <= GRACE_S);
+  CHECK(n[4].alarms == 0);
+  // And overall the estimator beats the single-tick rule
+  CHECK(n_err < o_err);
+
+  return checkResult("test_occupancy");
+}
@@ -0,0 +1,295 @@
+// OTA flasher end to end on the host: a local python http.server serves the
+// image, a socket Stream feeds otaJobStep() one loop() pass at a time, and a
+// RAM partition with modelled NOR timings stands in for Update. Reports the
+// update time and the per-step blocking (loop jitter); also covers hash
+// mismatch, stalls, oversize images and the key check.
+#include "Arduino.h"
+#include "ota.h"
+#include "check.h"
+#include <vector>
+#include <chrono>
+#include <random>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock Clock;
+
+// ---- Flash: ESP32 app slot (0x140000) with typical NOR timings ----
+const size_t SLOT_SIZE     = 0x140000;
+const size_t SECTOR        = 4096;
+const double ERASE_MS      = 45.0;  // Per 4 KB sector, typical
+const double PROGRAM_MS_KB = 2.8;   // 4 x 256 B pages at ~0.7 ms
+
+class RamFlash : public OtaFlash {
+public:
+  std::vector<uint8_t> data;
+  size_t size = 0, erased = 0;
+  bool committed = false, aborted = false;
+  double last_cost_ms = 0;
+  const char* err = "";
+
+  bool begin(size_t n) {
+    if (n > SLOT_SIZE) { err = "Not Enough Space"; return false; }
+    size = n; erased = 0; data.clear(); committed = aborted = false;
+    return true;
+  }
+  size_t write(uint8_t* d, size_t n) {
+    if (data.size() + n > size) { err = "Out of space"; return 0; }
+    last_cost_ms = PROGRAM_MS_KB * n / 1024.0;
+    while (erased < data.size() + n) { erased += SECTOR; last_cost_ms += ERASE_MS; }
+    data.insert(data.end(), d, d + n);
+    return n;
+  }
+  bool end() { committed = data.size() == size; if (!committed) err = "Size mismatch"; return committed; }
+  void abort() { aborted = true; }
+  const char* errorString() { return err; }
+};
+
+// ---- Transport: HTTP/1.0 GET over a plain socket, body exposed as Stream ----
+class SocketStream : public Stream {
+public:
+  int fd = -1, status = 0;
+  long length = -1;
+  std::string pending; // Body bytes that arrived with the headers
+
+  bool get(int port, const char* path) {
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in a = {};
+    a.sin_family = AF_INET; a.sin_port = htons(port); a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (sockaddr*)&a, sizeof(a)) != 0) { close(fd); fd = -1; return false; }
+    char req[256];
+    int n = snprintf(req, sizeof(req), "GET %s HTTP/1.0\r\nHost: 127.0.0.1\r\n\r\n", path);
+    if (send(fd, req, n, 0) != n) return false;
+    std::string head;
+    char buf[4096];
+    size_t end;
+    while ((end = head.find("\r\n\r\n")) == std::string::npos) {
+      ssize_t r = recv(fd, buf, sizeof(buf), 0);
+      if (r <= 0) return false;
+      head.append(buf, r);
+    }
+    pending = head.substr(end + 4);
+    head.resize(end);
+    sscanf(head.c_str(), "HTTP/%*s %d", &status);
+    size_t cl = head.find("Content-Length:");
+    if (cl != std::string::npos) length = atol(head.c_str() + cl + 15);
+    fcntl(fd, F_SETFL, O_NONBLOCK); // Like WiFiClient: available() never blocks
+    return true;
+  }
+  ~SocketStream() { if (fd >= 0) close(fd); }
+
+  int available() {
+    int n = 0;
+    ioctl(fd, FIONREAD, &n);
+    return pending.size() + n;
+  }
+  int read() { char c; return readBytes(&c, 1) == 1 ? (uint8_t)c : -1; }
+  size_t readBytes(char* b, size_t n) {
+    size_t got = min(n, pending.size());
+    memcpy(b, pending.data(), got);
+    pending.erase(0, got);
+    if (got < n) {
+      ssize_t r = recv(fd, b + got, n - got, 0);
+      if (r > 0) got += r;
+    }
+    return got;
+  }
+  size_t write(uint8_t) { return 0; }
+};
+
+// Feeds a buffer, optionally going silent after `stop_at` bytes
+class MemStream : public Stream {
+public:
+  std::vector<uint8_t> src;
+  size_t pos = 0, stop_at = SIZE_MAX;
+  int available() { return (int)(min(src.size(), stop_at) - pos); }
+  int read() { return available() > 0 ? src[pos++] : -1; }
+  size_t write(uint8_t) { return 0; }
+};
+
+static void sha256(const std::vector<uint8_t>& d, uint8_t out[32]) {
+  mbedtls_sha256_context c;
+  mbedtls_sha256_init(&c);
+  mbedtls_sha256_starts(&c, 0);
+  mbedtls_sha256_update(&c, d.data(), d.size());
+  mbedtls_sha256_finish(&c, out);
+}
+
+static std::vector<uint8_t> makeImage(size_t n) {
+  std::vector<uint8_t> img(n);
+  std::mt19937 rng(1);
+  for (auto& b : img) b = rng();
+  img[0] = 0xE9; // ESP image magic, for looks
+  return img;
+}
+
+// ---- Local server ----
+static pid_t startServer(const char* dir, int port) {
+  pid_t pid = fork();
+  if (pid == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, 1); dup2(null, 2);
+    char p[8]; snprintf(p, sizeof(p), "%d", port);
+    execlp("python3", "python3", "-m", "http.server", p, "--bind", "127.0.0.1", "--directory", dir, (char*)nullptr);
+    _exit(127);
+  }
+  for (int i = 0; i < 100; i++) { // Up to 5 s for the server to listen
+    usleep(50000);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in a = {};
+    a.sin_family = AF_INET; a.sin_port = htons(port); a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bool ok = connect(fd, (sockaddr*)&a, sizeof(a)) == 0;
+    close(fd);
+    if (ok) return pid;
+  }
+  kill(pid, SIGTERM);
+  return -1;
+}
+
+struct RunStats { double wall_ms, flash_ms; std::vector<double> step_ms; int steps, idle_steps; };
+
+// loop() stand-in: one otaJobStep per pass until the job leaves DOWNLOADING
+static RunStats download(OtaJob& job, RamFlash& flash, int port, const char* path, const uint8_t sha[32]) {
+  RunStats rs = {0, 0, {}, 0, 0};
+  SocketStream s;
+  CHECK(s.get(port, path));
+  CHECK(s.status == 200);
+  Clock::time_point t0 = Clock::now();
+  auto ms = [&] { return std::chrono::duration<double, std::milli>(Clock::now() - t0).count(); };
+  CHECK(otaJobBegin(job, &flash, &s, s.length, sha, 0));
+  while (job.state == OTA_DOWNLOADING && ms() < 30000) {
+    flash.last_cost_ms = 0;
+    int before = job.written;
+    double a = ms();
+    otaJobStep(job, (unsigned long)a);
+    double host = ms() - a;
+    if (job.written == before) { rs.idle_steps++; continue; }
+    rs.steps++;
+    rs.flash_ms += flash.last_cost_ms;
+    rs.step_ms.push_back(host + flash.last_cost_ms);
+  }
+  rs.wall_ms = ms();
+  return rs;
+}
+
+static double pctl(std::vector<double> v, double p) {
+  std::sort(v.begin(), v.end());
+  return v.empty() ? 0 : v[(size_t)(p * (v.size() - 1))];
+}
+
+static void testLive() {
+  char dir[] = "/tmp/ota_testXXXXXX";
+  CHECK(mkdtemp(dir) != nullptr);
+  std::vector<uint8_t> img = makeImage(1200 * 1024 + 123); // Not chunk aligned
+  std::string path = std::string(dir) + "/fw.bin";
+  FILE* f = fopen(path.c_str(), "wb");
+  fwrite(img.data(), 1, img.size(), f);
+  fclose(f);
+  uint8_t sha[32], bad[32];
+  sha256(img, sha);
+  memcpy(bad, sha, 32); bad[31] ^= 1;
+
+  int port = 20000 + getpid() % 20000;
+  pid_t srv = startServer(dir, port);
+  CHECK(srv > 0);
+  if (srv > 0) {
+    static OtaJob job;
+    RamFlash flash;
+    RunStats rs = download(job, flash, port, "/fw.bin", sha);
+    CHECK(job.state == OTA_DONE);
+    CHECK(job.written == (int)img.size());
+    CHECK(flash.committed && !flash.aborted);
+    CHECK(flash.data == img);
+    double sum = 0, sq = 0;
+    for (double v : rs.step_ms) { sum += v; sq += v * v; }
+    double mean = sum / rs.step_ms.size(), sd = sqrt(sq / rs.step_ms.size() - mean * mean);
+    printf("  %zu KB image over localhost: %d steps (+%d idle), host %.0f ms, modelled flash %.0f ms\n",
+           img.size() / 1024, rs.steps, rs.idle_steps, rs.wall_ms, rs.flash_ms);
+    printf("  loop blocked per step: mean %.2f ms, sd %.2f, p50 %.2f, p99 %.2f, max %.2f (4 KB erase every 4th chunk)\n",
+           mean, sd, pctl(rs.step_ms, 0.5), pctl(rs.step_ms, 0.99), pctl(rs.step_ms, 1.0));
+    // One chunk per pass keeps the worst stall to about one sector erase
+    CHECK(pctl(rs.step_ms, 1.0) < ERASE_MS + 20);
+
+    // Same image, wrong hash: flashed but never committed
+    RamFlash flash2;
+    download(job, flash2, port, "/fw.bin", bad);
+    CHECK(job.state == OTA_FAILED);
+    CHECK(strcmp(job.error, "SHA-256 mismatch") == 0);
+    CHECK(flash2.aborted && !flash2.committed);
+
+    SocketStream missing;
+    CHECK(missing.get(port, "/nope.bin") && missing.status == 404);
+
+    kill(srv, SIGTERM);
+    waitpid(srv, nullptr, 0);
+  }
+  unlink(path.c_str());
+  rmdir(dir);
+}
+
+static void testStallAndLimits() {
+  static OtaJob job;
+  RamFlash flash;
+  MemStream m;
+  m.src = makeImage(100000);
+  m.stop_at = 40000;
+  uint8_t sha[32];
+  sha256(m.src, sha);
+  CHECK(otaJobBegin(job, &flash, &m, m.src.size(), sha, 1000));
+  unsigned long now = 1000;
+  while (job.state == OTA_DOWNLOADING && now < 100000) otaJobStep(job, now += 10);
+  CHECK(job.state == OTA_FAILED);
+  CHECK(strcmp(job.error, "Download stalled") == 0);
+  CHECK(flash.aborted && !flash.committed);
+  CHECK(job.written == 40000);
+  CHECK(now >= 1000 + 40 * 10 + OTA_STALL_MS); // Not before the stall window
+
+  // Busy while downloading
+  MemStream m2; m2.src = m.src;
+  CHECK(otaJobBegin(job, &flash, &m2, m2.src.size(), sha, 0));
+  CHECK(!otaJobBegin(job, &flash, &m2, m2.src.size(), sha, 0));
+  CHECK(strcmp(job.error, "Busy") == 0);
+  while (job.state == OTA_DOWNLOADING) otaJobStep(job, 1);
+  CHECK(job.state == OTA_DONE);
+
+  // A server sending more than it announced cannot overrun the slot
+  MemStream m3; m3.src = m.src; m3.src.resize(150000);
+  CHECK(otaJobBegin(job, &flash, &m3, 100000, sha, 0));
+  while (job.state == OTA_DOWNLOADING) otaJobStep(job, 1);
+  CHECK(job.state == OTA_DONE && flash.data.size() == 100000);
+
+  // Oversize image and unknown length are refused up front
+  CHECK(!otaJobBegin(job, &flash, &m, SLOT_SIZE + 1, sha, 0));
+  CHECK(job.state == OTA_FAILED && strcmp(job.error, "Not Enough Space") == 0);
+  CHECK(!otaJobBegin(job, &flash, &m, -1, sha, 0));
+}
+
+static void testKeyAndSha() {
+  const char* key = "0f1e2d3c4b5a69788796a5b4c3d2e1f0";
+  CHECK(otaKeyMatch(key, key));
+  CHECK(!otaKeyMatch("", key));
+  CHECK(!otaKeyMatch("0f1e2d3c4b5a69788796a5b4c3d2e1f", key));   // Prefix
+  CHECK(!otaKeyMatch("0f1e2d3c4b5a69788796a5b4c3d2e1f00", key)); // Longer
+  CHECK(!otaKeyMatch("1f1e2d3c4b5a69788796a5b4c3d2e1f0", key));
+  CHECK(!otaKeyMatch("", ""));                                    // Unset key never matches
+
+  uint8_t out[32];
+  CHECK(otaParseSha("9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08", out));
+  CHECK(out[0] == 0x9f && out[31] == 0x08);
+  CHECK(!otaParseSha("9f86d081", out));
+  CHECK(!otaParseSha("zz86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08", out));
+}
+
+int main() {
+  testKeyAndSha();
+  testStallAndLimits();
+  printf("OTA over a local http.server into a simulated app slot:\n");
+  testLive();
+  return checkResult("test_ota");
+}
@@ -0,0 +1,226 @@
+// Playback queue on a virtual clock with the real songs.h table: bells and
+// alarms preempt music, preempted songs resume where they stopped, piano
+// tones end on time without blocking, and notes stay on the beat however
+// irregular loop() is.
+#include "Arduino.h"
+#include "songs.h"
+#include "play_queue.h"
+#include "check.h"
+#include <functional>
+#include <random>
+#include <vector>
+
+const int SONG_COUNT = sizeof(SONGS) / sizeof(SONGS[0]);
+const int BELL_ENTRY = 25, BELL_BREAK = 26, BELL_END = 27, SIREN_SMOKE = 34, NYAN = 36;
+
+struct Onset { unsigned long t; int song; int note; int freq; unsigned long due; };
+
+// Buzzer that logs every onset: a tone(f > 0) call, or a rest starting
+struct VirtualBuzzer : public PlayOutput {
+  Player* p = nullptr;
+  unsigned long now = 0;
+  std::vector<Onset> log;
+  int freq = 0;
+  void tone(int f) {
+    if (f == 0) { freq = 0; return; }
+    freq = f;
+    log.push_back({now, p->now.song, p->now.song >= 0 ? p->note_index : -1, f, p->note_start});
+  }
+  int songCount() { return SONG_COUNT; }
+  int songLength(int song) { return SONGS[song].length; }
+  int songNote(int song, int i, int &tempo) {
+    tempo = pgm_read_word(&(SONGS[song].tempo[i]));
+    return pgm_read_word(&(SONGS[song].melody[i]));
+  }
+};
+
+struct Sim {
+  VirtualBuzzer out;
+  Player p = {};
+  unsigned long now = 0;
+  Sim() { p.out = &out; out.p = &p; }
+  void at(unsigned long t) { now = t; out.now = t; }
+  // loop() every `tick` ms until `until`
+  void run(unsigned long until, unsigned long tick = 10) {
+    while (now + tick <= until) { at(now + tick); playTick(p, now); }
+  }
+  bool song(int id, uint8_t prio) { out.now = now; return playSong(p, id, prio, now); }
+  void piano(int f, int ms) { out.now = now; playTone(p, f, ms, now); }
+};
+
+// Nominal length of a song in ms, the way playTick() times it
+static unsigned long songMs(int id) {
+  unsigned long ms = 0;
+  for (int i = 0; i < SONGS[id].length; i++) {
+    unsigned long d = 1000 / pgm_read_word(&(SONGS[id].tempo[i]));
+    ms += (unsigned long)(d * PLAY_NOTE_GAP);
+  }
+  return ms;
+}
+
+// Songs in the order their first note sounded after t0, repeats collapsed
+static std::vector<int> order(const Sim &s, unsigned long t0 = 0) {
+  std::vector<int> v;
+  for (const Onset &o : s.out.log) {
+    if (o.t < t0) continue;
+    int id = o.song >= 0 ? o.song : -1;
+    if (v.empty() || v.back() != id) v.push_back(id);
+  }
+  return v;
+}
+
+static void testPreemption() {
+  Sim s;
+  s.song(0, PRIO_MUSIC);                 // Mario at boot
+  s.run(2000);
+  int paused_at = s.p.note_index;
+  s.song(BELL_ENTRY, PRIO_BELL);         // Scheduled bell
+  s.run(2010);
+  // Bell sounds on the next loop()
+  CHECK(s.out.log.back().song == BELL_ENTRY && s.out.log.back().t == 2010);
+  s.run(2000 + songMs(BELL_ENTRY) + 30);
+  // Music resumes at the interrupted note, within a tick of the bell's end
+  const Onset *resumed = nullptr;
+  for (const Onset &o : s.out.log) if (o.t > 2000 && o.song == 0) { resumed = &o; break; }
+  CHECK(resumed && resumed->note == paused_at);
+  if (resumed) {
+    long late = (long)resumed->t - (long)(2000 + songMs(BELL_ENTRY));
+    printf("  music resumed at note %d, %ld ms after the bell's nominal end\n", resumed->note, late);
+    CHECK(late >= 0 && late <= 20);
+  }
+  s.run(60000);
+  CHECK(!s.p.playing);
+  CHECK((order(s) == std::vector<int>{0, BELL_ENTRY, 0}));
+
+  // Alarm during a bell during music: alarm, rest of the bell, rest of the music
+  Sim a;
+  a.song(NYAN, PRIO_MUSIC);
+  a.run(1000);
+  a.song(BELL_BREAK, PRIO_BELL);
+  a.run(1300);
+  a.song(SIREN_SMOKE, PRIO_ALARM);
+  a.run(60000);
+  CHECK((order(a) == std::vector<int>{NYAN, BELL_BREAK, SIREN_SMOKE, BELL_BREAK, NYAN}));
+  // Every note of every song sounded exactly once overall (nothing skipped or replayed
+  // except the note cut off by preemption)
+  int nyan_notes = 0;
+  for (const Onset &o : a.out.log) nyan_notes += (o.song == NYAN);
+  CHECK(nyan_notes >= SONGS[NYAN].length && nyan_notes <= SONGS[NYAN].length + 1);
+}
+
+static void testStudentsCantClobberBells() {
+  // /music 36 and piano tones while a bell plays: bell plays in full first
+  Sim s;
+  s.song(BELL_BREAK, PRIO_BELL);
+  s.run(200);
+  s.song(NYAN, PRIO_MUSIC);
+  s.piano(880, 200);
+  s.run(400);
+  s.song(NYAN, PRIO_MUSIC);               // Impatient retry
+  s.run(60000);
+  int bell_notes = 0;
+  for (const Onset &o : s.out.log) bell_notes += (o.song == BELL_BREAK);
+  CHECK(bell_notes == SONGS[BELL_BREAK].length);
+  CHECK((order(s) == std::vector<int>{BELL_BREAK, NYAN, NYAN}) || (order(s) == std::vector<int>{BELL_BREAK, NYAN}));
+  for (const Onset &o : s.out.log) CHECK(o.freq != 880); // Piano dropped, not queued
+
+  // Duplicate bells don't stack while one is waiting
+  Sim d;
+  d.song(SIREN_SMOKE, PRIO_ALARM);
+  for (int i = 0; i < 5; i++) d.song(BELL_ENTRY, PRIO_BELL);
+  CHECK(d.p.queue_len == 1);
+  // Full queue: music is evicted for a bell, never the other way round
+  Sim f;
+  f.song(SIREN_SMOKE, PRIO_ALARM);
+  for (int i = 0; i < PLAY_QUEUE_SIZE; i++) playEnqueue(f.p, {(int16_t)i, 0, 0, 0, PRIO_MUSIC});
+  CHECK(f.p.queue_len == PLAY_QUEUE_SIZE);
+  CHECK(!playEnqueue(f.p, {1, 0, 0, 0, PRIO_MUSIC}));
+  CHECK(playEnqueue(f.p, {BELL_END, 0, 0, 0, PRIO_BELL}));
+  CHECK(f.p.queue[0].prio == PRIO_BELL && f.p.queue_len == PLAY_QUEUE_SIZE);
+
+  // "/stop" clears music but not bells
+  Sim st;
+  st.song(NYAN, PRIO_MUSIC);
+  st.run(500);
+  st.song(BELL_ENTRY, PRIO_BELL);
+  playStopMusic(st.p, st.now);
+  CHECK(st.p.playing && st.p.now.song == BELL_ENTRY && st.p.queue_len == 0);
+
+  // Ids are 0-based like the dashboard; /musik lists 25-27 as bells, 36 Nyan Cat
+  Sim ids;
+  CHECK(!ids.song(SONG_COUNT, PRIO_MUSIC) && !ids.song(-1, PRIO_MUSIC));
+  CHECK(ids.song(36, PRIO_MUSIC));
+  CHECK(strstr(SONGS[25].name, "Entry") && strstr(SONGS[27].name, "End") &&
+        strstr(SONGS[28].name, "Indonesia") && strstr(SONGS[31].name, "Butterfly") &&
+        strstr(SONGS[32].name, "Mario Long") && strstr(SONGS[36].name, "Nyan"));
+}
+
+static void testPiano() {
+  // Piano over music: 200 ms tone, then the song carries on
+  Sim s;
+  s.song(0, PRIO_MUSIC);
+  s.run(1000);
+  int at = s.p.note_index;
+  s.piano(440, 200);
+  CHECK(s.out.freq == 440);              // Sounds immediately, no delay()
+  s.run(1190);
+  CHECK(s.out.freq == 440);
+  s.run(1220);
+  CHECK(s.p.now.song == 0 && s.p.note_index == at);
+  // Rapid key presses: each replaces the last, nothing piles up
+  Sim k;
+  for (int i = 0; i < 20; i++) { k.piano(262 + 10 * i, 200); k.run(k.now + 50); }
+  CHECK(k.p.queue_len == 0 && k.out.freq == 452);
+  k.run(k.now + 200);
+  CHECK(!k.p.playing && k.out.freq == 0);
+}
+
+// Onsets vs. the nominal beat for a whole song under a given loop() pattern
+static void timing(const char* what, std::function<unsigned long(std::mt19937&)> tick, long max_late, bool stall) {
+  std::mt19937 rng(11);
+  Sim s;
+  s.at(1000);
+  s.song(0, PRIO_MUSIC);
+  while (s.p.playing) {
+    unsigned long dt = tick(rng);
+    if (stall && s.now > 4000 && s.now < 4100) dt = 2500; // TLS handshake in loop()
+    s.at(s.now + dt);
+    playTick(s.p, s.now);
+  }
+  // Each note is due exactly one period after the previous one, except
+  // after a stall, where the schedule restarts from the late tick
+  long worst = 0, earliest = 0, prev_t = -1;
+  unsigned long due = 1000;
+  int next = 0, short_notes = 0, off_beat = 0;
+  for (const Onset &o : s.out.log) {
+    while (next < o.note) {
+      due += (unsigned long)(1000 / pgm_read_word(&(SONGS[0].tempo[next])) * PLAY_NOTE_GAP);
+      next++;
+    }
+    if (o.due != due) {
+      if (o.due > due + 1000) due = o.due; // Stall
+      else off_beat++;
+    }
+    long late = (long)o.t - (long)o.due;
+    worst = std::max(worst, late);
+    earliest = std::min(earliest, late);
+    if (prev_t >= 0 && (long)o.t - prev_t < 50) short_notes++;
+    prev_t = o.t;
+  }
+  printf("  %-28s onsets %ld..%ld ms off the beat, song %5lu ms (nominal %lu), %d rushed notes\n",
+         what, earliest, worst, s.now - 1000, songMs(0), short_notes);
+  CHECK(off_beat == 0);     // Lateness never carries over to the next note
+  CHECK(earliest >= 0);     // Never ahead of the beat
+  CHECK(worst <= max_late); // At most one loop() late, and it doesn't add up
+  CHECK(short_notes == 0);
+}
+
+int main() {
+  testPreemption();
+  testStudentsCantClobberBells();
+  testPiano();
+  timing("loop() every 10 ms", [](std::mt19937&) { return 10UL; }, 10, false);
+  timing("loop() every 5-40 ms", [](std::mt19937 &r) { return 5UL + r() % 36; }, 40, false);
+  timing("5-40 ms with a 2.5 s stall", [](std::mt19937 &r) { return 5UL + r() % 36; }, 40, true);
+  return checkResult("test_play_queue");
+}
@@ -0,0 +1,297 @@
+// Power manager simulation: a virtual node runs loop()'s timers (DHT,
+// analog/occupancy, Telegram poll) over the room traces in traces/, with the
+// decisions from power.h. Reports duty cycle, average current and the delay
+// from a sound or an arrival to the node reading it, for the old flat-out
+// loop, modem sleep only, light sleep in every gap, and the power.h policy.
+// Light sleep drops the WiFi association, so every wake pays a rejoin and
+// the next Telegram poll a fresh TLS handshake.
+//
+// Currents and task costs below are datasheet figures and estimates, not
+// measurements; the comparisons between configurations are what matter.
+#include "Arduino.h"
+#include "occupancy.h"
+#include "power.h"
+#include "check.h"
+#include "traces.h"
+#include <random>
+#include <vector>
+
+// Node model (mA, ms)
+const double I_ACTIVE = 50;     // 240 MHz, WiFi modem sleep
+const double I_IDLE   = 25;     // 80 MHz, WiFi max modem sleep
+const double I_SLEEP  = 1.0;    // Light sleep, WiFi off, RTC + ext0 on
+const double I_RADIO  = 110;    // Radio busy: TLS request, association
+const unsigned long T_DHT    = 5;   // DHT22 read
+const unsigned long T_ANALOG = 40;  // 4 x smoothAnalog() (5 reads, 2 ms apart)
+const unsigned long T_ECHO_TIMEOUT = 30; // pulseIn() with nothing in range
+const unsigned long T_BOT    = 250; // getUpdates on a kept-alive TLS session
+const unsigned long T_WAKE   = 1;   // Light-sleep exit
+const unsigned long T_REJOIN = 600; // Association + DHCP after light sleep, in the WiFi task
+const unsigned long T_TLS    = 900; // Extra for the first poll after a rejoin
+const float PIN_HIGH_DB = 75;       // db (% of full scale) where GPIO32 reads HIGH: V_IH = 0.75 VDD
+
+struct Timers { const char* name; unsigned long dht, analog, bot; };
+const Timers SKETCH_TIMERS  = {"sketch timers", 2000, 1000, 3000};
+// Not in the sketch: what a slower night schedule would buy
+const Timers NIGHT_STRETCHED = {"10 s sense, 30 s poll", 30000, 10000, 30000};
+
+enum Config { CFG_FLAT_OUT, CFG_MODEM, CFG_EVERY_GAP, CFG_TIMERS, CFG_POLICY, CONFIGS };
+const char* CONFIG_NAMES[CONFIGS] = {
+  "flat out 240 MHz", "80 MHz modem sleep", "light sleep any gap", "policy, timers only", "policy + sound wake"
+};
+
+struct Result {
+  double duty;            // Fraction of time awake
+  double avg_ma;
+  int sleeps, sound_wakes, spurious;
+  int sound_events;       // Pin rising edges
+  double sound_lat_mean, sound_lat_max; // Rising edge -> next analog read (ms)
+  double woken_lat_max;   // Same, for edges that woke the node
+  double arrive_lat;      // First occupied label -> presence (s), -1 = never
+};
+
+struct Node {
+  const std::vector<Sample> &tr;
+  std::vector<unsigned long> pin_onset; // Per second: ms offset the pin goes HIGH, or none
+  unsigned long now = 0, last_dht = 0, last_analog = 0, last_bot = 0;
+  bool sense_now = false;
+  unsigned long wifi_up_at = 0; // Rejoin done
+  bool tls_stale = false;       // Next poll redoes the handshake
+  Occupancy occ = {};
+  bool presence = false;
+  PowerMeter meter = {};
+  SoundWake sw = {};
+  double charge = 0;      // mA*ms
+  unsigned long awake = 0;
+
+  Node(const std::vector<Sample> &t) : tr(t) {
+    std::mt19937 rng(5);
+    for (size_t s = 0; s < tr.size(); s++) pin_onset.push_back(tr[s].db >= PIN_HIGH_DB ? rng() % 1000 : 1000);
+  }
+  unsigned long end() const { return tr.size() * 1000; }
+  const Sample &at(unsigned long t) const { return tr[std::min<size_t>(t / 1000, tr.size() - 1)]; }
+  bool pinHigh(unsigned long t) const { return t % 1000 >= pin_onset[std::min<size_t>(t / 1000, tr.size() - 1)]; }
+  // First instant in (from, to] the pin is HIGH, or 0
+  unsigned long pinRise(unsigned long from, unsigned long to) const {
+    for (unsigned long s = from / 1000; s * 1000 <= to && s < tr.size(); s++) {
+      unsigned long t = s * 1000 + pin_onset[s];
+      if (pin_onset[s] < 1000 && t > from && t <= to) return t;
+      if (pin_onset[s] < 1000 && t <= from && from < s * 1000 + 1000) return from + 1; // Already HIGH
+    }
+    return 0;
+  }
+  bool wifiUp() const { return now >= wifi_up_at; }
+  double cpuMa() const { return meter.state == POWER_ACTIVE ? I_ACTIVE : I_IDLE; }
+  void spend(unsigned long ms, double ma) { charge += ms * ma; awake += ms; now += ms; }
+};
+
+static Result simulate(const std::vector<Sample> &tr, Config cfg, bool day, const Timers &tm) {
+  Node n(tr);
+  Result r = {};
+  n.meter.state = cfg == CFG_FLAT_OUT ? POWER_ACTIVE : POWER_IDLE;
+  std::vector<unsigned long> reads;       // Analog read instants
+  unsigned long woke_at = 0;
+  int first_occ = -1;
+  for (size_t s = 0; s < tr.size(); s++) if (tr[s].label && first_occ < 0) first_occ = s;
+  long detect = -1;
+
+  while (n.now < n.end()) {
+    // ---- loop() body ----
+    if (n.now - n.last_dht > tm.dht) { n.last_dht = n.now; n.spend(T_DHT, n.cpuMa()); }
+    bool analog_due = n.now - n.last_analog > tm.analog;
+    if (analog_due || n.sense_now) {
+      if (analog_due) n.last_analog = n.now;
+      n.sense_now = false;
+      reads.push_back(n.now);
+      if (woke_at) { r.woken_lat_max = std::max(r.woken_lat_max, (double)(n.now - woke_at)); woke_at = 0; }
+      const Sample &smp = n.at(n.now);
+      n.spend(T_ANALOG + (smp.dist == 0 ? T_ECHO_TIMEOUT : (unsigned long)(smp.dist * 0.0588)), n.cpuMa());
+      n.presence = occupancyUpdate(n.occ, smp.dist, smp.db, smp.lux, true, true);
+      if (n.presence && detect < 0 && first_occ >= 0 && n.now >= (unsigned long)first_occ * 1000) detect = n.now;
+    }
+    if (n.wifiUp() && n.now - n.last_bot > tm.bot) {
+      n.last_bot = n.now;
+      n.spend(T_BOT + (n.tls_stale ? T_TLS : 0), I_RADIO);
+      n.tls_stale = false;
+    }
+
+    // ---- powerManage() ----
+    unsigned long due[] = { n.last_dht + tm.dht + 1, n.last_analog + tm.analog + 1,
+                            n.wifiUp() ? n.last_bot + tm.bot + 1 : n.wifi_up_at };
+    unsigned long wait = powerWait(due, 3, n.now, POWER_MAX_SLEEP_MS);
+    if (cfg == CFG_FLAT_OUT) { n.spend(std::max(wait, 1UL), I_ACTIVE); continue; }
+
+    bool busy = n.presence;
+    if (soundWakeUpdate(n.sw, busy, n.now)) n.meter.spurious_wakes++;
+    PowerState st = powerDecide(busy, day, n.wifiUp(), wait);
+    if (cfg == CFG_MODEM && st == POWER_SLEEP) st = POWER_IDLE;
+    if (cfg == CFG_EVERY_GAP && st == POWER_IDLE && !day && n.wifiUp() && wait >= 20) st = POWER_SLEEP;
+    if (st != POWER_SLEEP) {
+      powerAccount(n.meter, st, n.now * 1000LL);
+      n.spend(std::max(wait, 1UL), n.cpuMa()); // loop() spins until a timer is due
+      continue;
+    }
+    bool armed = cfg == CFG_POLICY && soundWakeArm(n.sw, true, !n.pinHigh(n.now), n.now);
+    unsigned long until = n.now + wait;
+    unsigned long rise = armed ? n.pinRise(n.now, until) : 0;
+    if (rise) until = rise;
+    powerAccount(n.meter, POWER_SLEEP, n.now * 1000LL);
+    n.charge += (until - n.now) * I_SLEEP;
+    n.now = until;
+    n.meter.sleeps++;
+    powerAccount(n.meter, POWER_IDLE, n.now * 1000LL);
+    n.spend(T_WAKE, I_IDLE);
+    // WiFi.begin(): radio busy while the loop carries on at the low clock
+    n.wifi_up_at = n.now + T_REJOIN;
+    n.charge += T_REJOIN * (I_RADIO - I_IDLE);
+    n.tls_stale = true;
+    if (rise) {
+      n.meter.sound_wakes++;
+      soundWakeFired(n.sw, n.now);
+      woke_at = rise;
+      n.sense_now = true;
+    }
+  }
+
+  r.duty = (double)n.awake / n.now;
+  r.avg_ma = n.charge / n.now;
+  r.sleeps = n.meter.sleeps;
+  r.sound_wakes = n.meter.sound_wakes;
+  r.spurious = n.meter.spurious_wakes;
+  // Sound rising edges -> next analog read
+  double sum = 0;
+  size_t k = 0;
+  for (size_t s = 1; s < tr.size(); s++) {
+    if (!(tr[s].db >= PIN_HIGH_DB && tr[s - 1].db < PIN_HIGH_DB)) continue;
+    unsigned long onset = s * 1000 + n.pin_onset[s];
+    while (k < reads.size() && reads[k] < onset) k++;
+    if (k == reads.size()) continue;
+    double lat = reads[k] - onset;
+    r.sound_events++;
+    sum += lat;
+    r.sound_lat_max = std::max(r.sound_lat_max, lat);
+  }
+  r.sound_lat_mean = r.sound_events ? sum / r.sound_events : 0;
+  r.arrive_lat = (detect >= 0) ? (detect - first_occ * 1000.0) / 1000 : -1;
+  return r;
+}
+
+static void testDecisions() {
+  // Deadlines across millis() wrap
+  unsigned long now = 0xFFFFFF00UL;
+  unsigned long due[] = { now + 700, now + 300 }; // Second one wraps past 0
+  CHECK(powerWait(due, 2, now, 1000) == 300);
+  unsigned long late[] = { now - 5, now + 300 };
+  CHECK(powerWait(late, 2, now, 1000) == 0);
+  CHECK(powerDecide(true, false, true, POWER_MAX_SLEEP_MS) == POWER_ACTIVE);
+  CHECK(powerDecide(false, true, true, POWER_MAX_SLEEP_MS) == POWER_IDLE);
+  CHECK(powerDecide(false, false, true, POWER_MIN_SLEEP_MS - 1) == POWER_IDLE);
+  CHECK(powerDecide(false, false, false, POWER_MAX_SLEEP_MS) == POWER_IDLE); // Rejoining / AP fallback
+  CHECK(powerDecide(false, false, true, POWER_MIN_SLEEP_MS) == POWER_SLEEP);
+  // A sleep has to save more than the rejoin and the TLS handshake cost
+  double break_even = (T_REJOIN + T_TLS) * (I_RADIO - I_IDLE) / (I_IDLE - I_SLEEP);
+  printf("  light sleep pays off above %.0f ms (POWER_MIN_SLEEP_MS %lu)\n", break_even, POWER_MIN_SLEEP_MS);
+  CHECK(POWER_MIN_SLEEP_MS >= break_even);
+
+  // Sound wake: never armed on a HIGH pin or a faulty channel
+  SoundWake sw = {};
+  CHECK(soundWakeArm(sw, true, true, now));
+  CHECK(!soundWakeArm(sw, true, false, now) && !soundWakeArm(sw, false, true, now));
+  // Spurious wakes double the hold-off up to the cap, across the wrap
+  unsigned long holds[8];
+  for (int i = 0; i < 8; i++) {
+    soundWakeFired(sw, now);
+    CHECK(!soundWakeArm(sw, true, true, now + 1)); // Pending: not re-armed
+    CHECK(!soundWakeUpdate(sw, false, now + POWER_WAKE_CONFIRM_MS - 1));
+    CHECK(soundWakeUpdate(sw, false, now + POWER_WAKE_CONFIRM_MS));
+    now += POWER_WAKE_CONFIRM_MS;
+    holds[i] = sw.hold_ms;
+    CHECK(!soundWakeArm(sw, true, true, now + sw.hold_ms - 1));
+    CHECK(soundWakeArm(sw, true, true, now + sw.hold_ms));
+    now += sw.hold_ms;
+  }
+  CHECK(holds[0] == POWER_BACKOFF_MIN_MS && holds[1] == 2 * POWER_BACKOFF_MIN_MS);
+  CHECK(holds[7] == POWER_BACKOFF_MAX_MS);
+  // A confirmed wake (room got busy) resets the back-off
+  soundWakeFired(sw, now);
+  CHECK(!soundWakeUpdate(sw, true, now + 5000));
+  CHECK(sw.spurious == 0 && soundWakeArm(sw, true, true, now + 5001));
+
+  // Accounting
+  PowerMeter m = {};
+  CHECK(!powerAccount(m, POWER_ACTIVE, 1000));
+  CHECK(powerAccount(m, POWER_SLEEP, 3000));
+  CHECK(powerAccount(m, POWER_IDLE, 10000));
+  CHECK(m.time_us[POWER_ACTIVE] == 3000 && m.time_us[POWER_SLEEP] == 7000);
+}
+
+static void printRow(const char* trace, Config cfg, const Result &r) {
+  printf("  %-20s %-20s %5.1f%% %7.1f %6d %6d %4d %6.0f / %5.0f %8.1f\n", trace, CONFIG_NAMES[cfg], 100 * r.duty,
+         r.avg_ma, r.sleeps, r.sound_wakes, r.spurious, r.sound_lat_mean, r.sound_lat_max, r.arrive_lat);
+}
+
+int main() {
+  testDecisions();
+
+  struct Trace { const char* file; bool day; };
+  const Trace traces[] = {
+    {"class_day.csv", true}, {"quiet_exam.csv", true},
+    {"night_intruder.csv", false}, {"empty_desk_echo.csv", false}, {"empty_traffic.csv", false},
+  };
+  const char* header = "  %-20s %-20s %6s %7s %6s %6s %4s %14s %8s\n";
+  printf("%s:\n", SKETCH_TIMERS.name);
+  printf(header, "trace", "config", "awake", "avg mA", "sleeps", "swakes", "spur", "sound->read ms", "arrive s");
+  for (const Trace &t : traces) {
+    std::vector<Sample> tr = loadTrace(t.file);
+    CHECK(!tr.empty());
+    if (tr.empty()) continue;
+    Result res[CONFIGS];
+    const Config run[] = {CFG_FLAT_OUT, CFG_MODEM, CFG_EVERY_GAP, CFG_POLICY};
+    for (Config c : run) {
+      res[c] = simulate(tr, c, t.day, SKETCH_TIMERS);
+      printRow(t.file, c, res[c]);
+    }
+    const Result &flat = res[CFG_FLAT_OUT], &modem = res[CFG_MODEM], &gap = res[CFG_EVERY_GAP], &pol = res[CFG_POLICY];
+    // Gaps of at most a second never pay for a rejoin: the policy stays in
+    // modem sleep, day and night
+    CHECK(pol.sleeps == 0);
+    CHECK(pol.avg_ma <= flat.avg_ma);
+    if (!t.day) {
+      CHECK(gap.avg_ma > modem.avg_ma); // Rejoining every second costs more than it saves
+      CHECK(pol.avg_ma < flat.avg_ma * 0.75);
+    }
+    if (flat.arrive_lat >= 0) CHECK(pol.arrive_lat >= 0 && pol.arrive_lat <= flat.arrive_lat + 1);
+  }
+
+  // A slower night schedule leaves windows long enough for light sleep,
+  // and the sound wake covers the gaps between readings
+  printf("%s (not in the sketch):\n", NIGHT_STRETCHED.name);
+  for (const Trace &t : traces) {
+    if (t.day) continue;
+    std::vector<Sample> tr = loadTrace(t.file);
+    if (tr.empty()) continue;
+    Result res[CONFIGS];
+    const Config run[] = {CFG_MODEM, CFG_TIMERS, CFG_POLICY};
+    for (Config c : run) {
+      res[c] = simulate(tr, c, false, NIGHT_STRETCHED);
+      printRow(t.file, c, res[c]);
+    }
+    const Result &modem = res[CFG_MODEM], &timers = res[CFG_TIMERS], &pol = res[CFG_POLICY];
+    CHECK(pol.sleeps > 0);
+    CHECK(pol.avg_ma < modem.avg_ma);
+    CHECK(pol.avg_ma <= timers.avg_ma * 1.05); // Sound wakes cost little
+    if (modem.arrive_lat >= 0) CHECK(pol.arrive_lat >= 0);
+    if (pol.sound_wakes) {
+      CHECK(pol.sound_lat_mean < timers.sound_lat_mean);
+      CHECK(pol.woken_lat_max <= T_WAKE + T_DHT); // At most a DHT read in between
+    }
+  }
+  // Trucks past an empty room: back-off keeps the wake count well under the
+  // number of loud passes
+  std::vector<Sample> traffic = loadTrace("empty_traffic.csv");
+  Result tw = simulate(traffic, CFG_POLICY, false, NIGHT_STRETCHED);
+  printf("  empty_traffic: %d loud onsets, %d sound wakes (%d spurious), woken reads within %.0f ms\n",
+         tw.sound_events, tw.sound_wakes, tw.spurious, tw.woken_lat_max);
+  CHECK(tw.sound_wakes > 0 && tw.sound_wakes <= 6);
+  return checkResult("test_power");
+}
@@ -0,0 +1,281 @@
+// ReplyWriter: chunk framing, JSON escaping and buffer boundaries, plus an
+// allocations-per-reply benchmark against the String += replies it replaced.
+// Built with -Wl,--wrap=malloc (see Makefile) so malloc calls are counted.
+#include "Arduino.h"
+#include "reply_writer.h"
+#include "compliance.h"
+#include "check.h"
+#include <chrono>
+#include <new>
+
+char reply_buf[REPLY_BUF_SIZE];
+
+// ---- Allocation counting ----
+static size_t allocs = 0;
+extern "C" void* __real_malloc(size_t n);
+extern "C" void* __wrap_malloc(size_t n) { allocs++; return __real_malloc(n); }
+void* operator new(size_t n) { allocs++; void* p = __real_malloc(n ? n : 1); if (!p) throw std::bad_alloc(); return p; }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// ---- Sinks ----
+struct CapturePrint : public Print {
+  std::string out;
+  size_t write(uint8_t c) { out += (char)c; return 1; }
+  size_t write(const uint8_t* b, size_t n) { out.append((const char*)b, n); return n; }
+};
+
+// Discards output but keeps a running checksum so the work is not optimised away
+struct NullPrint : public Print {
+  uint32_t sum = 0;
+  size_t write(uint8_t c) { sum += c; return 1; }
+  size_t write(const uint8_t* b, size_t n) { for (size_t i = 0; i < n; i++) sum += b[i]; return n; }
+};
+
+static std::string sink_body;
+static int sink_calls = 0, sink_ends = 0;
+static size_t sink_max = 0;
+static void captureSink(const char* data, size_t len) {
+  sink_calls++;
+  if (len == 0) { sink_ends++; return; }
+  sink_body.append(data, len);
+  sink_max = max(sink_max, len);
+}
+static void resetSink() { sink_body.clear(); sink_calls = sink_ends = 0; sink_max = 0; }
+
+// Strict HTTP/1.1 chunked decoder; returns false on any framing error
+static bool decodeChunked(const std::string& raw, std::string& body, size_t& max_chunk) {
+  size_t pos = 0;
+  body.clear(); max_chunk = 0;
+  for (;;) {
+    size_t eol = raw.find("\r\n", pos);
+    if (eol == std::string::npos) return false;
+    char* endp;
+    unsigned long n = strtoul(raw.c_str() + pos, &endp, 16);
+    if (endp != raw.c_str() + eol) return false;
+    pos = eol + 2;
+    if (n == 0) return raw.compare(pos, std::string::npos, "\r\n") == 0;
+    if (pos + n + 2 > raw.size() || raw.compare(pos + n, 2, "\r\n") != 0) return false;
+    body.append(raw, pos, n);
+    max_chunk = max(max_chunk, (size_t)n);
+    pos += n + 2;
+  }
+}
+
+static std::string pattern(size_t n) {
+  std::string s;
+  for (size_t i = 0; i < n; i++) s += (char)('a' + i % 26);
+  return s;
+}
+
+static void testChunkBoundaries() {
+  const size_t sizes[] = {0, 1, REPLY_BUF_SIZE - 1, REPLY_BUF_SIZE, REPLY_BUF_SIZE + 1,
+                          2 * REPLY_BUF_SIZE, 5000};
+  for (size_t n : sizes) {
+    std::string src = pattern(n), body;
+    CapturePrint cap;
+    ReplyWriter w(&cap);
+    w.write((const uint8_t*)src.data(), src.size());
+    w.end();
+    size_t max_chunk;
+    CHECK(decodeChunked(cap.out, body, max_chunk));
+    CHECK(body == src);
+    CHECK(max_chunk <= REPLY_BUF_SIZE);
+    CHECK(w.total() == n);
+
+    resetSink();
+    ReplyWriter f(captureSink);
+    for (char c : src) f.print(c); // Byte at a time across the boundary
+    f.end();
+    CHECK(sink_body == src);
+    CHECK(sink_ends == 1);
+    CHECK(sink_max <= REPLY_BUF_SIZE);
+    CHECK(sink_calls == (int)((n + REPLY_BUF_SIZE - 1) / REPLY_BUF_SIZE) + 1);
+  }
+}
+
+// Undo the JSON string escaping; returns false on a raw control character
+static bool unescape(const std::string& s, std::string& out) {
+  out.clear();
+  for (size_t i = 0; i < s.size(); i++) {
+    unsigned char c = s[i];
+    if (c < 0x20 || c == '"') return false;
+    if (c != '\\') { out += c; continue; }
+    char e = s[++i];
+    switch (e) {
+      case '"': out += '"'; break;
+      case '\\': out += '\\'; break;
+      case 'n': out += '\n'; break;
+      case 'r': out += '\r'; break;
+      case 't': out += '\t'; break;
+      case 'u': out += (char)strtoul(s.substr(i + 1, 4).c_str(), nullptr, 16); i += 4; break;
+      default: return false;
+    }
+  }
+  return true;
+}
+
+static void testEscape() {
+  std::string src;
+  for (int r = 0; r < 3; r++)
+    for (int c = 1; c < 256; c++) src += (char)c; // Escapes straddle the 512 boundary
+  src += "Halo \"kelas\"\n🌡 26.5C\\";
+  resetSink();
+  ReplyWriter w(captureSink);
+  w.print("{\"text\":\"");
+  w.setEscape(true);
+  w.print(src.c_str());
+  w.setEscape(false);
+  w.print("\"}");
+  w.end();
+  const std::string& j = sink_body;
+  CHECK(j.compare(0, 9, "{\"text\":\"") == 0);
+  CHECK(j.compare(j.size() - 2, 2, "\"}") == 0);
+  std::string back;
+  CHECK(unescape(j.substr(9, j.size() - 11), back));
+  CHECK(back == src);
+  CHECK(j.find("\\u001f") != std::string::npos);
+}
+
+static void testPrintf() {
+  resetSink();
+  ReplyWriter w(captureSink);
+  std::string longArg = pattern(300);
+  size_t n = w.printf_P(PSTR("[%s]"), longArg.c_str());
+  w.printf_P(PSTR("|%u.%u%%|%d"), 95u, 3u, -7);
+  w.end();
+  CHECK(n == REPLY_FMT_MAX - 1);                        // Truncated, not overflowed
+  CHECK(sink_body.compare(0, 2, "[a") == 0);
+  CHECK(sink_body.substr(REPLY_FMT_MAX - 1) == "|95.3%|-7");
+}
+
+// ---- Benchmark: the old String += replies next to the writer ----
+// Stand-in for Arduino String: heap-backed with a small inline buffer, like
+// the ESP32 core's (std::string SSO here is 15 bytes, the core's 11).
+struct String {
+  std::string s;
+  String() {}
+  String(const char* c) : s(c) {}
+  String(const std::string& c) : s(c) {}
+  explicit String(int v) : s(std::to_string(v)) {}
+  explicit String(unsigned v) : s(std::to_string(v)) {}
+  explicit String(float v) { char b[16]; snprintf(b, sizeof(b), "%.2f", v); s = b; }
+  String& operator+=(const String& o) { s += o.s; return *this; }
+  String& operator+=(const char* o) { s += o; return *this; }
+  friend String operator+(String a, const String& b) { a.s += b.s; return a; }
+  friend String operator+(String a, const char* b) { a.s += b; return a; }
+  friend String operator+(const char* a, const String& b) { return String(a) + b; }
+};
+
+const MetricSpec SPEC[4] = {
+  {"Suhu", "C", 180, 300, 10}, {"Lembab", "%", 400, 600, 20},
+  {"Suara", "dB", 0, 550, 20}, {"Udara", "PPM", 0, 10000, 640}
+};
+static MetricStats stats[4];
+const float t = 27.35, h = 61.2, db = 48.7;
+const int gas_mq135 = 812;
+const char* health_status = "Perlu Ventilasi";
+
+static String statusOld() {
+  String msg = "🏥 *Laporan Kesehatan*\n";
+  msg += "🌡 " + String(t) + "C (Std: 18-30)\n";
+  msg += "💧 " + String(h) + "% (Std: 40-60)\n";
+  msg += "🔊 " + String(db) + "dB (Max: 55)\n";
+  msg += "💨 AQI: " + String(gas_mq135) + " (Max: 1000)\n";
+  msg += "🚭 Asap: " + String("AMAN") + "\n";
+  msg += "📊 Status: " + String(health_status);
+  return msg;
+}
+
+static void statusNew(ReplyWriter& w) {
+  w.print("🏥 *Laporan Kesehatan*\n");
+  w.printf_P(PSTR("🌡 %.2fC (Std: 18-30)\n"), t);
+  w.printf_P(PSTR("💧 %.2f%% (Std: 40-60)\n"), h);
+  w.printf_P(PSTR("🔊 %.2fdB (Max: 55)\n"), db);
+  w.printf_P(PSTR("💨 AQI: %d (Max: 1000)\n"), gas_mq135);
+  w.printf_P(PSTR("🚭 Asap: %s\n"), "AMAN");
+  w.print("📊 Status: "); w.print(health_status);
+}
+
+static String reportOld(const char* title) {
+  String msg = String(title) + "\n";
+  for (int m = 0; m < 4; m++) {
+    const MetricStats& st = stats[m];
+    const MetricSpec& sp = SPEC[m];
+    msg += "\n*" + String(sp.name) + "*: ";
+    unsigned pct10 = (uint64_t)st.in_range * 1000 / st.samples;
+    int p50 = statPercentile(st, sp, 50), p95 = statPercentile(st, sp, 95);
+    msg += String(pct10 / 10) + "." + String(pct10 % 10) + "% sesuai standar\n";
+    msg += "P50 " + String(p50 / 10) + "." + String(p50 % 10) + " / P95 " + String(p95 / 10) + "." + String(p95 % 10) + " " + sp.unit + "\n";
+    msg += "Lewat batas: " + String((unsigned)st.exceed_count) + "x, terlama " + String((unsigned)(st.exceed_max / 60)) + " mnt\n";
+  }
+  unsigned total = stats[0].samples;
+  msg += "\n⏱️ Jam pelajaran terpantau: " + String(total / 3600) + "j " + String((total / 60) % 60) + "m";
+  return msg;
+}
+
+template <typename F>
+static void bench(const char* name, F reply, size_t& allocs_out) {
+  const int N = 20000;
+  reply(); // Warm-up
+  size_t a0 = allocs;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < N; i++) reply();
+  auto t1 = std::chrono::steady_clock::now();
+  allocs_out = (allocs - a0) / N;
+  double us = std::chrono::duration<double, std::micro>(t1 - t0).count() / N;
+  printf("  %-24s %3zu allocations/reply  %6.2f us/reply (host)\n", name, allocs_out, us);
+}
+
+static void testAllocations() {
+  for (int m = 0; m < 4; m++)
+    for (int i = 0; i < 28800; i++) statAdd(stats[m], SPEC[m], SPEC[m].lo + (i * 37) % (SPEC[m].hi - SPEC[m].lo + 100));
+
+  NullPrint sink;
+  size_t old_status, new_status, old_report, new_report, core_printf;
+  printf("allocations per reply (message body only):\n");
+  bench("/status String +=", [&] { String s = statusOld(); sink.write((const uint8_t*)s.s.data(), s.s.size()); }, old_status);
+  bench("/status ReplyWriter", [&] { ReplyWriter w(&sink); statusNew(w); w.end(); }, new_status);
+  bench("/report String +=", [&] { String s = reportOld("📋 *Laporan Kepatuhan (Hari Ini)*"); sink.write((const uint8_t*)s.s.data(), s.s.size()); }, old_report);
+  bench("/report ReplyWriter", [&] { ReplyWriter w(&sink); statReport(w, stats, SPEC, 4, stats[0].samples, "📋 *Laporan Kepatuhan (Hari Ini)*", true); w.end(); }, new_report);
+  // Print::printf past 64 bytes is why writeReport must use printf_P
+  bench("Print::printf 80 chars", [&] { sink.printf("%s", "0123456789012345678901234567890123456789012345678901234567890123456789012345678"); }, core_printf);
+
+  CHECK(old_status > 5 && old_report > 20);
+  CHECK(new_status == 0);
+  CHECK(new_report == 0);
+  CHECK(core_printf == 1);
+
+  // Both report paths produce the same text
+  CapturePrint cap;
+  resetSink();
+  ReplyWriter w(captureSink);
+  statReport(w, stats, SPEC, 4, stats[0].samples, "T", true);
+  w.end();
+  CHECK(sink_body == reportOld("T").s);
+  // DHT22 faulted all day: temperature and humidity empty, class time and
+  // the other metrics still reported
+  MetricStats no_dht[4] = {};
+  no_dht[2] = stats[2];
+  no_dht[3] = stats[3];
+  resetSink();
+  ReplyWriter d(captureSink);
+  statReport(d, no_dht, SPEC, 4, 8 * 3600, "T", true);
+  d.end();
+  CHECK(sink_body.find("*Suhu*: belum ada data") != std::string::npos);
+  CHECK(sink_body.find("*Suara*: ") != std::string::npos && sink_body.find("sesuai standar") != std::string::npos);
+  CHECK(sink_body.find("terpantau: 8j 0m") != std::string::npos);
+  resetSink();
+  ReplyWriter s(captureSink);
+  statusNew(s);
+  s.end();
+  CHECK(sink_body == statusOld().s);
+}
+
+int main() {
+  testChunkBoundaries();
+  testEscape();
+  testPrintf();
+  testAllocations();
+  return checkResult("test_reply_writer");
+}
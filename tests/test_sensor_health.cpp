@@ -0,0 +1,159 @@
+// Sensor health detectors against fault and no-fault traces: boot, lights
+// switching, silent nights, lessons, floating pins, stuck and saturated
+// ADCs, DHT dropouts. Counts fault/recover transitions (each one is a Telegram
+// message), plus the per-tick cost.
+#include "Arduino.h"
+#include "sensor_health.h"
+#include "check.h"
+#include "traces.h"
+#include <random>
+#include <chrono>
+#include <functional>
+
+// Same as SENSOR_SPEC in the sketch
+const ChannelSpec TEMP = {"t",   -40.0, 80.0,   3600, 0,   -1};
+const ChannelSpec GAS  = {"gas",   0.0, 4095.0, 300,  400, -1};
+const ChannelSpec DB   = {"db",   -1.0, 4095.0, 0,    1100, 0};
+const ChannelSpec LUX  = {"lux",  -1.0, 4096.0, 0,    500, -1};
+
+struct Run { int transitions; int first_fault_tick; uint8_t final_fault; uint8_t first_fault; };
+
+static Run replay(const ChannelSpec& sp, int ticks, std::function<float(int)> gen) {
+  ChannelHealth hs = {};
+  Run r = {0, -1, FAULT_NONE, FAULT_NONE};
+  for (int i = 0; i < ticks; i++) {
+    if (sensorUpdate(hs, sp, gen(i))) {
+      r.transitions++;
+      if (r.first_fault_tick < 0) { r.first_fault_tick = i; r.first_fault = hs.fault; }
+    }
+  }
+  r.final_fault = hs.fault;
+  return r;
+}
+
+// smoothAnalog() of a floating pin: 5 reads of a pin wandering rail to rail
+static float floating(std::mt19937& rng) {
+  std::uniform_real_distribution<float> u(0, 4095);
+  float s = 0;
+  float base = u(rng);
+  for (int k = 0; k < 5; k++) s += constrain(base + (u(rng) - 2047) * 0.3f, 0.0f, 4095.0f);
+  return (int)(s / 5);
+}
+
+int main() {
+  std::mt19937 rng(3);
+  std::normal_distribution<float> n1(0, 1), n5(0, 5), n30(0, 30);
+
+  // 1. Boot: the first readings sit far from zero. The old EMA started at 0
+  //    and flagged MQ135 as floating within two ticks.
+  Run boot = replay(GAS, 3600, [&](int) { return (int)(1800 + n5(rng)); });
+  CHECK(boot.transitions == 0);
+  // MQ heater warm-up: steep ramp over the first minutes, then settle
+  Run heat = replay(GAS, 3600, [&](int i) { return (int)(300 + 1500 * (1 - exp(-i / 120.0)) + n5(rng)); });
+  CHECK(heat.transitions == 0);
+
+  // 2. Lights on/off every 10 minutes, people walking past the LDR
+  Run lights = replay(LUX, 8 * 3600, [&](int i) {
+    float base = ((i / 600) % 2) ? 2600 : 350;
+    return constrain(base + n30(rng), 0.0f, 4095.0f);
+  });
+  CHECK(lights.transitions == 0);
+  // Flicker: a failing tube toggling every few seconds for a minute
+  Run flicker = replay(LUX, 3600, [&](int i) {
+    bool on = (i > 1800 && i < 1860) ? (i / 3) % 2 : 1;
+    return (on ? 2600.0f : 350.0f) + n30(rng);
+  });
+  printf("  lux flicker burst: %d transitions\n", flicker.transitions);
+  CHECK(flicker.transitions <= 2);
+
+  // 3. Silent night on the sound channel: hours of exact zeros
+  Run night = replay(DB, 12 * 3600, [&](int i) { return (i < 3600 ? 400 + n30(rng) : 0.0f); });
+  CHECK(night.transitions == 0);
+  // ...with a click every few seconds (HVAC, a door down the hall)
+  Run clicks = replay(DB, 12 * 3600, [&](int i) { return (i % 5 == 0) ? 1500 + n30(rng) * 10 : 0.0f; });
+  CHECK(clicks.transitions == 0);
+  // Lessons, breaks and trucks from the occupancy traces, as raw ADC
+  const char* rooms[] = {"class_day.csv", "quiet_exam.csv", "empty_traffic.csv"};
+  for (const char* name : rooms) {
+    std::vector<Sample> tr = loadTrace(name);
+    CHECK(!tr.empty());
+    Run room = replay(DB, tr.size(), [&](int i) { return (int)(tr[i].db * 40.95f); });
+    CHECK(room.transitions == 0);
+  }
+  // Floating sound pin: the one that fed logicAI() random "speech"
+  Run fsnd = replay(DB, 600, [&](int) { return floating(rng); });
+  printf("  floating sound pin: first fault at tick %d (%s), %d transitions\n",
+         fsnd.first_fault_tick, sensorFaultName(fsnd.first_fault), fsnd.transitions);
+  CHECK(fsnd.first_fault == FAULT_NOISY && fsnd.transitions == 1);
+  CHECK(fsnd.first_fault_tick >= SENSOR_WARMUP - 1 && fsnd.first_fault_tick < 90);
+  // Reconnected into a silent room: the quiet floor still clears it
+  ChannelHealth snd = {};
+  for (int i = 0; i < 300; i++) sensorUpdate(snd, DB, floating(rng));
+  CHECK(snd.fault == FAULT_NOISY);
+  int snd_clear = -1;
+  for (int i = 0; i < 600 && snd_clear < 0; i++) {
+    sensorUpdate(snd, DB, 0);
+    if (snd.fault == FAULT_NONE) snd_clear = i;
+  }
+  printf("  floating sound pin reconnected, silent room: clear after %d ticks\n", snd_clear);
+  CHECK(snd_clear >= SENSOR_CLEAR_TICKS - 1 && snd_clear < 120);
+
+  // 4. Floating gas pin: raised once, after warm-up, and it stays raised
+  Run flo = replay(GAS, 600, [&](int) { return floating(rng); });
+  printf("  floating MQ pin: first fault at tick %d (%s), %d transitions\n",
+         flo.first_fault_tick, sensorFaultName(flo.first_fault), flo.transitions);
+  CHECK(flo.first_fault == FAULT_NOISY);
+  CHECK(flo.first_fault_tick >= SENSOR_WARMUP - 1 && flo.first_fault_tick < 90);
+  CHECK(flo.transitions == 1);
+  // ...and recovers once reconnected
+  ChannelHealth hs = {};
+  for (int i = 0; i < 300; i++) sensorUpdate(hs, GAS, floating(rng));
+  CHECK(hs.fault == FAULT_NOISY);
+  int recovered = -1;
+  for (int i = 0; i < 600 && recovered < 0; i++) {
+    sensorUpdate(hs, GAS, (int)(900 + n5(rng)));
+    if (hs.fault == FAULT_NONE) recovered = i;
+  }
+  printf("  floating MQ pin reconnected: clear after %d ticks\n", recovered);
+  CHECK(recovered >= SENSOR_CLEAR_TICKS - 1 && recovered < 120);
+
+  // 5. Stuck mid-scale ADC vs. a pin sitting on the rail
+  Run stuck = replay(GAS, 1000, [&](int i) { return i < 100 ? (int)(1200 + n5(rng)) : 1234.0f; });
+  CHECK(stuck.first_fault == FAULT_STUCK && stuck.final_fault == FAULT_STUCK);
+  CHECK(stuck.first_fault_tick == 100 + GAS.stuck_ticks);
+  Run rail = replay(GAS, 1000, [&](int i) { return i < 100 ? (int)(1200 + n5(rng)) : 4095.0f; });
+  CHECK(rail.first_fault == FAULT_RAIL && rail.final_fault == FAULT_RAIL && rail.transitions == 1);
+
+  // 6. Chattering rail: 6 ticks saturated, 1 tick just below, for an hour.
+  //    Without clear hysteresis that was a fault/recover pair every 7 s.
+  Run chatter = replay(GAS, 3600, [&](int i) { return (i % 7 == 6) ? 4050.0f : 4095.0f; });
+  printf("  chattering rail for 1 h: %d transitions\n", chatter.transitions);
+  CHECK(chatter.transitions == 1);
+
+  // 7. DHT dropouts: single NaNs are tolerated, a dead sensor is reported
+  //    once, and recovery needs SENSOR_CLEAR_TICKS good reads
+  Run dht = replay(TEMP, 2000, [&](int i) {
+    if (i % 50 == 10) return NAN;                  // Sporadic checksum errors
+    if (i >= 1000 && i < 1200) return NAN;         // Unplugged
+    return 26.0f + 0.1f * (int)(10 * n1(rng)) / 10;
+  });
+  CHECK(dht.first_fault == FAULT_NAN && dht.first_fault_tick == 1000 + SENSOR_NAN_LIMIT - 1);
+  CHECK(dht.transitions == 2 && dht.final_fault == FAULT_NONE);
+  // Dead from boot: still reported, right after warm-up
+  Run dead = replay(TEMP, 100, [&](int) { return NAN; });
+  CHECK(dead.first_fault == FAULT_NAN && dead.first_fault_tick == SENSOR_WARMUP - 1);
+
+  // Per-tick cost (host): 6 channels per analog tick in the sketch
+  ChannelHealth bench = {};
+  std::vector<float> vals(1 << 16);
+  for (auto& v : vals) v = 1000 + n30(rng);
+  const int N = 20000000;
+  int changes = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  for (int i = 0; i < N; i++) changes += sensorUpdate(bench, GAS, vals[i & 0xFFFF]);
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / N;
+  printf("  sensorUpdate: %.1f ns/tick on the host, %zu bytes state per channel (%d changes)\n",
+         ns, sizeof(ChannelHealth), changes);
+
+  return checkResult("test_sensor_health");
+}
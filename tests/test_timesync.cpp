@@ -0,0 +1,127 @@
+// Time service simulation: a skewed, temperature-wandering crystal, hourly
+// SNTP samples with network delay and jitter, missed polls and a 12 h
+// outage. Checks holdover state, drift compensation against a clock that
+// only steps at each sync, and that timeErrorMs() bounds the actual error.
+#include "Arduino.h"
+#include "timesync.h"
+#include "check.h"
+#include <random>
+
+const int64_t S = 1000000;            // µs
+const int64_t T0 = 1760000000LL * S;  // Unix start (2025-10-09)
+
+struct Scenario {
+  const char* name;
+  double skew_ppm;      // Crystal offset, + = runs slow
+  double wander_ppm;    // Daily temperature swing amplitude
+  double outage_from_h, outage_to_h;
+};
+
+struct SimResult {
+  double max_err_ms, max_err_outage_ms, max_err_outage_raw_ms;
+  int bound_violations, checks;
+  bool saw_holdover, recovered;
+  float drift_ppm;
+};
+
+static SimResult simulate(const Scenario& sc, uint32_t seed) {
+  SimResult r = {0, 0, 0, 0, 0, false, false, 0};
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> jitter(0, 8e3);          // µs
+  std::uniform_real_distribution<double> delay(5e3, 60e3);  // One-way, µs
+  std::uniform_real_distribution<double> u(0, 1);
+
+  TimeService ts = {}, raw = {}; // raw: same samples, no drift correction
+  const double day = 86400.0;
+  const int64_t step = 10 * S;   // Integrate the crystal in 10 s steps
+  double mono = 0;               // Local monotonic µs
+  int64_t next_poll = 60 * S;    // First SNTP reply a minute after boot
+  for (int64_t t = 0; t <= 4 * 86400 * S; t += step) {
+    double tt = t / 1e6;
+    double ppm = sc.skew_ppm + sc.wander_ppm * sin(2 * M_PI * tt / day);
+    mono += step / (1 + ppm * 1e-6);
+    int64_t m = (int64_t)mono, wall = T0 + t;
+
+    bool outage = tt >= sc.outage_from_h * 3600 && tt < sc.outage_to_h * 3600;
+    if (t >= next_poll) {
+      next_poll += 3600 * S;
+      if (!outage && u(rng) > 0.05) { // 5% of polls lost anyway
+        int64_t sample = wall + (int64_t)(delay(rng) + jitter(rng));
+        timeApplySync(ts, sample, m);
+        timeApplySync(raw, sample, m);
+        raw.drift_ppm = 0;
+      }
+    }
+    timeUpdateState(ts, m);
+    if (ts.sync == TIME_UNSYNCED) continue;
+    if (ts.sync == TIME_HOLDOVER) r.saw_holdover = true;
+    if (r.saw_holdover && ts.sync == TIME_SYNCED && !outage) r.recovered = true;
+
+    double err = fabs((double)(timeAt(ts, m) - wall)) / 1e3;
+    double err_raw = fabs((double)(timeAt(raw, m) - wall)) / 1e3;
+    r.max_err_ms = fmax(r.max_err_ms, err);
+    if (outage) {
+      r.max_err_outage_ms = fmax(r.max_err_outage_ms, err);
+      r.max_err_outage_raw_ms = fmax(r.max_err_outage_raw_ms, err_raw);
+    }
+    r.checks++;
+    if (err > timeErrorMs(ts, m)) r.bound_violations++;
+  }
+  r.drift_ppm = ts.drift_ppm;
+  return r;
+}
+
+static void testBasics() {
+  TimeService ts = {};
+  CHECK(timeErrorMs(ts, 0) == UINT32_MAX);
+  timeApplySync(ts, T0, 5 * S);
+  CHECK(ts.sync == TIME_SYNCED);
+  CHECK(timeAt(ts, 65 * S) == T0 + 60 * S);
+  CHECK(timeErrorMs(ts, 5 * S) == TIME_SYNC_ERR_MS);
+  // Exactly 100 ppm slow over 1 h: the first estimate is taken whole
+  timeApplySync(ts, T0 + 3600 * S + 360000, 3605 * S);
+  CHECK_NEAR(ts.drift_ppm, 100, 0.01);
+  CHECK(ts.drift_samples == 1);
+  // Samples closer than TIME_DRIFT_MIN_GAP only re-anchor
+  timeApplySync(ts, T0 + 3700 * S, 3700 * S);
+  CHECK(ts.drift_samples == 1);
+  // Implausible jumps (manual clock change upstream) do not poison the drift
+  timeApplySync(ts, T0 + 9000 * S, 7300 * S);
+  CHECK(ts.drift_samples == 1);
+  timeUpdateState(ts, 7300 * S + TIME_HOLDOVER_S * S + S);
+  CHECK(ts.sync == TIME_HOLDOVER);
+}
+
+int main() {
+  testBasics();
+
+  const Scenario scenarios[] = {
+    {"nominal +12 ppm",  12, 2, 30, 42},
+    {"slow +45 ppm",     45, 5, 30, 42},
+    {"fast -80 ppm",    -80, 5, 50, 62},
+    {"hot room +25/10",  25, 10, 30, 42},
+  };
+  printf("4 days, hourly SNTP (5-60 ms one-way delay, 8 ms jitter, 5%% lost), 12 h outage:\n");
+  for (const Scenario& sc : scenarios) {
+    int violations = 0, checks = 0;
+    SimResult worst = {0, 0, 0, 0, 0, true, true, 0};
+    for (uint32_t seed = 1; seed <= 20; seed++) {
+      SimResult r = simulate(sc, seed);
+      violations += r.bound_violations; checks += r.checks;
+      worst.max_err_ms = fmax(worst.max_err_ms, r.max_err_ms);
+      worst.max_err_outage_ms = fmax(worst.max_err_outage_ms, r.max_err_outage_ms);
+      worst.max_err_outage_raw_ms = fmax(worst.max_err_outage_raw_ms, r.max_err_outage_raw_ms);
+      worst.saw_holdover &= r.saw_holdover;
+      worst.recovered &= r.recovered;
+      if (seed == 1) worst.drift_ppm = r.drift_ppm;
+    }
+    printf("  %-16s max err %6.0f ms | outage: compensated %6.0f ms, uncompensated %6.0f ms | bound misses %d/%d | drift est %.1f ppm\n",
+           sc.name, worst.max_err_ms, worst.max_err_outage_ms, worst.max_err_outage_raw_ms,
+           violations, checks, worst.drift_ppm);
+    CHECK(worst.saw_holdover && worst.recovered);
+    CHECK(violations == 0);
+    CHECK(worst.max_err_outage_ms < worst.max_err_outage_raw_ms / 2);
+    CHECK(worst.max_err_ms < 1000); // Bells stay on the right second
+  }
+  return checkResult("test_timesync");
+}
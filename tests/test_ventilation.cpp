@@ -0,0 +1,127 @@
+// Checks the sliding least-squares against a direct fit, then replays a
+// school day through a simple room model twice: once with the forecast
+// fan levels and once with the old rule (fan fully on iff t > 28 C).
+#include "Arduino.h"
+#include "ventilation.h"
+#include "check.h"
+#include <random>
+
+const VentLimits LIM = {1000, 28.0, 30.0};
+const float FAN_SHARE[FAN_LEVELS] = {0, 110 / 255.0, 180 / 255.0, 1.0}; // FAN_DUTY
+
+// Direct O(n) least squares over the ring in chronological order
+static double directForecast(const TrendRing& r, double steps) {
+  int n = r.count;
+  double si = 0, sy = 0, sii = 0, siy = 0;
+  for (int i = 0; i < n; i++) {
+    double y = r.buf[(r.idx - n + i + VENT_WINDOW) % VENT_WINDOW];
+    si += i; sy += y; sii += (double)i * i; siy += i * y;
+  }
+  double slope = (n * siy - si * sy) / (n * sii - si * si);
+  return sy / n + slope * ((n - 1) + steps - si / n);
+}
+
+static void testTrend() {
+  TrendRing r = {};
+  CHECK(trendForecast(r, 60) == 0);
+  for (int i = 0; i < 100; i++) trendPush(r, 400 + 5.0 * i); // Exact line
+  CHECK_NEAR(trendForecast(r, 60), 400 + 5.0 * (99 + 60), 0.5);
+
+  // Noisy CO2-like series over a week of 10 s samples: the running sums
+  // must not drift away from a fresh fit
+  std::mt19937 rng(7);
+  std::normal_distribution<float> noise(0, 30);
+  double worst = 0;
+  for (int i = 0; i < 60000; i++) {
+    trendPush(r, 800 + 300 * sin(i / 500.0) + noise(rng));
+    if (i % 997 == 0) worst = fmax(worst, fabs(trendForecast(r, 60) - directForecast(r, 60)));
+  }
+  printf("  trend: worst |running - direct| after 60000 samples = %.3f ppm\n", worst);
+  CHECK(worst < 5.0);
+}
+
+// ---- Room model, 1 s steps ----
+// 30 pupils in 180 m3: +45 ppm/min CO2; 0.5 air changes/h infiltration,
+// up to 6/h more with the fan at full duty. Body heat +0.04 C/min.
+struct Room { double co2, temp; };
+
+struct DayResult {
+  double co2_over_min;   // Occupied minutes with CO2 > limit
+  double temp_over_min;  // Occupied minutes with t > comfort threshold
+  double fan_on_min;     // Minutes with the fan running at any level
+  double fan_energy;     // Full-duty-equivalent minutes
+  int switches;          // Level changes
+  double co2_peak;
+};
+
+static bool occupiedAt(int sec) {
+  int m = sec / 60; // Minutes since 07:00
+  return (m < 150) || (m >= 180 && m < 300) || (m >= 360 && m < 480);
+}
+
+static double outsideTemp(int sec) {
+  return 25.0 + 3.0 * sin(M_PI * sec / (9 * 3600.0)); // Peaks late morning
+}
+
+template <typename Policy>
+static DayResult simulateDay(Policy policy) {
+  DayResult d = {0, 0, 0, 0, 0, 0};
+  Room room = {450, 26.5};
+  std::mt19937 rng(42);
+  std::normal_distribution<double> co2_noise(0, 15), t_noise(0, 0.1);
+  int level = 0;
+  for (int sec = 0; sec < 9 * 3600; sec++) {
+    bool occ = occupiedAt(sec);
+    double ach = 0.5 + 6.0 * FAN_SHARE[level]; // Air changes per hour
+    double exch = ach / 3600.0;
+    room.co2 += (occ ? 45.0 / 60 : 0) - (room.co2 - 420) * exch;
+    room.temp += (occ ? 0.04 / 60 : 0) + (outsideTemp(sec) - room.temp) * exch * 0.5;
+
+    float co2 = room.co2 + co2_noise(rng), t = room.temp + t_noise(rng);
+    int next = policy(sec, occ, co2, t);
+    if (next != level) d.switches++;
+    level = next;
+
+    if (occ && room.co2 > LIM.co2_max) d.co2_over_min += 1 / 60.0;
+    if (occ && room.temp > LIM.temp_on) d.temp_over_min += 1 / 60.0;
+    if (level > 0) d.fan_on_min += 1 / 60.0;
+    d.fan_energy += FAN_SHARE[level] / 60.0;
+    d.co2_peak = fmax(d.co2_peak, room.co2);
+  }
+  return d;
+}
+
+static void print(const char* name, const DayResult& d) {
+  printf("  %-9s CO2>1000: %5.1f min  t>28: %5.1f min  fan on: %5.1f min (%.1f full-duty min, %d switches)  peak %4.0f ppm\n",
+         name, d.co2_over_min, d.temp_over_min, d.fan_on_min, d.fan_energy, d.switches, d.co2_peak);
+}
+
+int main() {
+  testTrend();
+
+  Ventilation v = {};
+  int level = 0;
+  DayResult now = simulateDay([&](int sec, bool occ, float co2, float t) {
+    if (sec % (VENT_SAMPLE_MS / 1000) == 0) ventilationSample(v, co2, t, true, true);
+    if (occ) level = ventilationLevel(v, LIM, co2, t, true, true, level);
+    else level = co2 > LIM.co2_max ? 1 : 0; // Empty room: flush bad air only
+    return level;
+  });
+  DayResult old = simulateDay([](int, bool occ, float, float t) {
+    return (occ && t > 28.0) ? FAN_LEVELS - 1 : 0;
+  });
+  printf("school day 07:00-16:00 (room model):\n");
+  print("forecast", now);
+  print("old", old);
+
+  // Forecast control keeps CO2 far below where the temperature-only rule lets it go
+  CHECK(now.co2_over_min < old.co2_over_min / 4);
+  CHECK(now.co2_peak < old.co2_peak);
+  CHECK(now.temp_over_min <= old.temp_over_min + 1);
+  // Per-second noise must not make the fan chatter between levels
+  CHECK(now.switches < 200);
+
+  // Blind sensors: keep some air moving
+  CHECK(ventilationLevel(v, LIM, 0, 0, false, false, 0) == 1);
+  return checkResult("test_ventilation");
+}
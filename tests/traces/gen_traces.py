@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Generates the labeled occupancy traces used by tests/test_occupancy.cpp.
+
+The traces are synthetic. They are modeled on what the node's sensors report
+once per second, in the same units readAnalogSensors() produces:
+  dist  ultrasonic cm, 0 = no echo (pulseIn timeout)
+  db    smoothed sound ADC scaled to 0..100
+  lux   smoothed LDR ADC, 0..4095
+  label 1 = room occupied (ground truth), 0 = empty
+
+Re-run after changing a scenario; the output is deterministic:
+  python3 tests/traces/gen_traces.py
+"""
+import os
+import random
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def clamp(v, lo, hi):
+    return max(lo, min(hi, v))
+
+
+class Room:
+    def __init__(self, seed, lux, quiet_db):
+        self.rng = random.Random(seed)
+        self.lux = lux
+        self.quiet_db = quiet_db
+        self.rows = []
+
+    def tick(self, dist, db, label):
+        r = self.rng
+        lux = clamp(self.lux + r.gauss(0, 6), 0, 4095)
+        self.rows.append((len(self.rows), round(dist, 1), round(clamp(db, 0, 100), 1), round(lux), label))
+
+    # Empty room: wall echo or nothing, background noise, rare ghost echoes
+    def empty(self, secs, ghost_rate=0.0, ghost_burst=1):
+        r = self.rng
+        burst = 0
+        for _ in range(secs):
+            if burst == 0 and r.random() < ghost_rate:
+                burst = r.randint(1, ghost_burst)
+            if burst:
+                dist = r.uniform(60, 140)
+                burst -= 1
+            else:
+                dist = 0 if r.random() < 0.05 else r.gauss(320, 2)
+            self.tick(dist, self.quiet_db + r.gauss(0, 2), 0)
+
+    # Students at desks: near echo most of the time, fidgeting, talking
+    def lesson(self, secs, talk_db=55, talk_share=0.7):
+        r = self.rng
+        for _ in range(secs):
+            if r.random() < 0.85:
+                dist = clamp(r.gauss(95, 30), 25, 300)
+            else:
+                dist = 0 if r.random() < 0.5 else r.uniform(150, 320)
+            db = (talk_db + r.gauss(0, 8)) if r.random() < talk_share else (self.quiet_db + 6 + r.gauss(0, 3))
+            self.tick(dist, db, 1)
+
+    def truck(self, secs, peak_db=75):
+        r = self.rng
+        for _ in range(secs):
+            dist = 0 if r.random() < 0.05 else r.gauss(320, 2)
+            self.tick(dist, peak_db + r.gauss(0, 4), 0)
+
+    def write(self, name, note):
+        path = os.path.join(HERE, name)
+        with open(path, "w") as f:
+            f.write("# %s\n" % note)
+            f.write("sec,dist,db,lux,label\n")
+            for row in self.rows:
+                f.write("%d,%s,%s,%d,%d\n" % row)
+
+
+def class_day():
+    room = Room(1, lux=900, quiet_db=34)
+    room.empty(600, ghost_rate=0.01)
+    room.lux = 1500               # Lights switched on as the class walks in
+    room.lesson(1500)
+    room.lux = 900
+    room.empty(600, ghost_rate=0.01)
+    room.write("class_day.csv", "empty 10 min, lesson 25 min (lights on), empty 10 min")
+
+
+def quiet_exam():
+    room = Room(2, lux=1500, quiet_db=30)
+    room.empty(300)
+    room.lesson(1800, talk_db=36, talk_share=0.1)
+    room.empty(300)
+    room.write("quiet_exam.csv", "silent exam: people at desks, almost no speech")
+
+
+def traffic():
+    room = Room(3, lux=1100, quiet_db=35)
+    for _ in range(12):
+        room.empty(room.rng.randint(120, 240))
+        room.truck(room.rng.randint(4, 10))
+    room.empty(120)
+    room.write("empty_traffic.csv", "empty room, loud trucks passing every 2-4 min")
+
+
+def desk_echo():
+    room = Room(4, lux=1000, quiet_db=34)
+    room.empty(2400, ghost_rate=0.04, ghost_burst=3)
+    room.write("empty_desk_echo.csv", "empty room, spurious near echoes off desks (1-3 ticks)")
+
+
+def night_intruder():
+    room = Room(5, lux=40, quiet_db=12)
+    room.empty(1200)
+    r = room.rng
+    for _ in range(180):          # Quiet walk with a torch
+        room.lux = clamp(40 + r.choice([0, 0, 300, 600]), 0, 4095)
+        dist = clamp(r.gauss(110, 50), 20, 320) if r.random() < 0.8 else 0
+        room.tick(dist, 22 + r.gauss(0, 5), 1)
+    room.lux = 40
+    room.empty(1200)
+    room.write("night_intruder.csv", "dark silent room, 3 min intruder with torch")
+
+
+if __name__ == "__main__":
+    class_day()
+    quiet_exam()
+    traffic()
+    desk_echo()
+    night_intruder()
@@ -0,0 +1,78 @@
+#ifndef TIMESYNC_H
+#define TIMESYNC_H
+
+#include "Arduino.h"
+
+// ================= TIME SERVICE =================
+// Wall clock = monotonic + offset from the last NTP sample, drift-corrected
+// between syncs. Pure functions of the monotonic time passed in, so tests/
+// can run days of skewed crystals and NTP outages in a few milliseconds.
+const uint32_t TIME_HOLDOVER_S    = 7200;  // SNTP polls hourly; 2 misses = holdover
+const uint32_t TIME_DRIFT_MIN_GAP = 600;   // Shorter sync gaps can't resolve ppm
+const float TIME_DRIFT_MAX_PPM    = 500;   // Anything beyond is a bad sample
+const float TIME_DRIFT_ALPHA      = 0.3;   // Drift estimate smoothing
+const int   TIME_DRIFT_LEARNED    = 3;     // Samples before the estimate is trusted
+const float TIME_UNCERT_PPM       = 100;   // Assumed error before drift is learned
+const float TIME_UNCERT_LEARNED   = 10;    // ...floor after, widened by sample scatter
+const uint32_t TIME_SYNC_ERR_MS   = 100;   // One SNTP sample: one-way delay + jitter
+
+enum TimeSync { TIME_UNSYNCED, TIME_SYNCED, TIME_HOLDOVER };
+
+struct TimeService {
+  TimeSync sync;
+  int64_t base_mono;   // Monotonic µs at last NTP sync
+  int64_t base_wall;   // Unix µs at last NTP sync
+  float drift_ppm;     // + = local crystal runs slow
+  float drift_dev;     // Mean |measured - estimate| (ppm), sample scatter
+  int drift_samples;
+};
+
+// Wall-clock µs at monotonic instant mono
+inline int64_t timeAt(const TimeService &ts, int64_t mono) {
+  int64_t el = mono - ts.base_mono;
+  return ts.base_wall + el + (int64_t)(el * (double)ts.drift_ppm * 1e-6);
+}
+
+inline uint32_t timeSinceSyncS(const TimeService &ts, int64_t mono) {
+  return (mono - ts.base_mono) / 1000000;
+}
+
+// Worst-case wall error: the sync sample's own error plus what the crystal
+// can have drifted since, given how well the drift is known
+inline uint32_t timeErrorMs(const TimeService &ts, int64_t mono) {
+  if (ts.sync == TIME_UNSYNCED) return UINT32_MAX;
+  float ppm = ts.drift_samples >= TIME_DRIFT_LEARNED ? max(TIME_UNCERT_LEARNED, 3 * ts.drift_dev)
+                                                      : TIME_UNCERT_PPM;
+  return TIME_SYNC_ERR_MS + timeSinceSyncS(ts, mono) * ppm / 1000;
+}
+
+inline void timeApplySync(TimeService &ts, int64_t wall, int64_t mono) {
+  if (ts.sync != TIME_UNSYNCED) {
+    // What we predicted for this instant vs. what NTP says = drift over the gap
+    int64_t predicted = timeAt(ts, mono);
+    float el_s = (mono - ts.base_mono) / 1e6;
+    if (el_s >= TIME_DRIFT_MIN_GAP) {
+      float measured = ts.drift_ppm + (wall - predicted) / el_s;
+      if (fabs(measured) <= TIME_DRIFT_MAX_PPM) {
+        if (ts.drift_samples == 0) {
+          ts.drift_ppm = measured; // First estimate: take it whole, not 30% of it
+        } else {
+          ts.drift_dev += TIME_DRIFT_ALPHA * (fabs(measured - ts.drift_ppm) - ts.drift_dev);
+          ts.drift_ppm += TIME_DRIFT_ALPHA * (measured - ts.drift_ppm);
+        }
+        ts.drift_samples++;
+      }
+    }
+  }
+  ts.base_wall = wall;
+  ts.base_mono = mono;
+  ts.sync = TIME_SYNCED;
+}
+
+// Call every tick: falls back to holdover when SNTP has been quiet too long
+inline void timeUpdateState(TimeService &ts, int64_t mono) {
+  if (ts.sync == TIME_UNSYNCED) return;
+  ts.sync = (timeSinceSyncS(ts, mono) > TIME_HOLDOVER_S) ? TIME_HOLDOVER : TIME_SYNCED;
+}
+
+#endif
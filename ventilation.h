@@ -0,0 +1,109 @@
+#ifndef VENTILATION_H
+#define VENTILATION_H
+
+#include "Arduino.h"
+
+// ================= VENTILATION FORECAST =================
+// CO2 and temperature rings with a sliding least-squares fit, and the fan
+// level decision. Pure logic so tests/ can run it against a room model.
+#define VENT_WINDOW     30    // Samples in regression ring
+#define FAN_LEVELS      4     // 0 = Off, 1 = Pre-vent, 2 = Normal, 3 = Boost
+const unsigned long VENT_SAMPLE_MS = 10000; // 30 x 10 s = 5 min history
+const float VENT_HORIZON_MIN = 10.0;        // Look-ahead for threshold crossing
+const float VENT_HYST_CO2  = 50.0;          // ppm below a limit before stepping down
+const float VENT_HYST_TEMP = 0.5;           // C below a limit before stepping down
+
+struct TrendRing {
+  float buf[VENT_WINDOW];
+  float sum_y;   // Σ y
+  float sum_iy;  // Σ i*y, i = 0 (oldest) .. count-1 (newest)
+  int idx;
+  int count;
+};
+
+struct Ventilation {
+  TrendRing co2;
+  TrendRing temp;
+  float co2_forecast;   // Predicted at now + VENT_HORIZON_MIN
+  float temp_forecast;
+};
+
+struct VentLimits {
+  float co2_max;   // Ventilate above this (ppm)
+  float temp_on;   // Comfort threshold (C)
+  float temp_max;  // Boost above this (C)
+};
+
+// Slides the window by one sample: dropping the oldest shifts every index
+// down by one, so Σ i*y loses (Σ y - oldest) and gains (n-1)*newest.
+// Float rounding in the running sums accumulates, so they are rebuilt from
+// the buffer once per lap (O(VENT_WINDOW) every VENT_WINDOW pushes).
+inline void trendPush(TrendRing &r, float v) {
+  if (r.count == VENT_WINDOW) {
+    float old = r.buf[r.idx];
+    r.sum_iy -= (r.sum_y - old);
+    r.sum_y -= old;
+    r.sum_iy += (VENT_WINDOW - 1) * v;
+  } else {
+    r.sum_iy += r.count * v;
+    r.count++;
+  }
+  r.buf[r.idx] = v;
+  r.sum_y += v;
+  r.idx = (r.idx + 1) % VENT_WINDOW;
+
+  if (r.idx == 0 && r.count == VENT_WINDOW) {
+    r.sum_y = 0; r.sum_iy = 0;
+    for (int i = 0; i < VENT_WINDOW; i++) { // idx 0 is now the oldest
+      r.sum_y += r.buf[i];
+      r.sum_iy += i * r.buf[i];
+    }
+  }
+}
+
+// Least-squares line through the ring, evaluated steps_ahead past the newest sample.
+inline float trendForecast(const TrendRing &r, float steps_ahead) {
+  int n = r.count;
+  if (n == 0) return 0;
+  float mean_y = r.sum_y / n;
+  if (n < 3) return mean_y;
+  float sum_i = n * (n - 1) / 2.0;                  // Σ i
+  float sum_ii = (n - 1) * n * (2.0 * n - 1) / 6.0; // Σ i²
+  float slope = (n * r.sum_iy - sum_i * r.sum_y) / (n * sum_ii - sum_i * sum_i);
+  float mean_i = sum_i / n;
+  return mean_y + slope * ((n - 1) + steps_ahead - mean_i);
+}
+
+// One VENT_SAMPLE_MS sample. Faulty channels keep their old window.
+inline void ventilationSample(Ventilation &v, float co2, float t, bool co2_ok, bool t_ok) {
+  if (co2_ok) trendPush(v.co2, co2);
+  if (t_ok) trendPush(v.temp, t);
+  float steps = VENT_HORIZON_MIN * 60000.0 / VENT_SAMPLE_MS;
+  v.co2_forecast = trendForecast(v.co2, steps);
+  v.temp_forecast = trendForecast(v.temp, steps);
+}
+
+// Level the readings call for, with every threshold lowered by margin.
+inline int ventilationDemand(const Ventilation &v, const VentLimits &lim, float co2, float t,
+                             bool co2_ok, bool t_ok, float co2_margin, float t_margin) {
+  float co2_max = lim.co2_max - co2_margin;
+  if (!co2_ok && !t_ok) return 1; // Blind: keep some air moving
+  // Already over: boost when far past the limit
+  if ((co2_ok && co2 > lim.co2_max * 1.5 - co2_margin) || (t_ok && t > lim.temp_max - t_margin)) return 3;
+  if ((co2_ok && co2 > co2_max) || (t_ok && t > lim.temp_on - t_margin)) return 2;
+  // Heading over within the horizon: ventilate early and gently
+  if ((co2_ok && v.co2_forecast > co2_max) || (t_ok && v.temp_forecast > lim.temp_on - t_margin)) return 1;
+  return 0;
+}
+
+// Fan level for an occupied room. Steps up at the limits but only steps
+// down once the readings are VENT_HYST_* below them, so sensor noise
+// around a threshold does not toggle the fan every tick.
+inline int ventilationLevel(const Ventilation &v, const VentLimits &lim, float co2, float t,
+                            bool co2_ok, bool t_ok, int current) {
+  int up = ventilationDemand(v, lim, co2, t, co2_ok, t_ok, 0, 0);
+  int hold = ventilationDemand(v, lim, co2, t, co2_ok, t_ok, VENT_HYST_CO2, VENT_HYST_TEMP);
+  return max(up, min(current, hold));
+}
+
+#endif